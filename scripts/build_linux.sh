@@ -0,0 +1,55 @@
+#!/bin/sh
+# Builds the headless Linux host and the tests into ./out
+# Set GAME=TestBed to build the test bed instead of the default game.
+#
+# out/Project256HeadlessReload runs the game from out/libProject256.so and
+# picks up every new build of it, GAME_MODULE_ONLY=1 rebuilds just that.
+
+set -e
+
+cd "$(dirname "$0")/.."
+
+CXX=${CXX:-g++}
+CXXFLAGS="-std=c++20 -O2 -pthread"
+
+if [ "$GAME" = "TestBed" ]; then
+    CXXFLAGS="$CXXFLAGS -DGAME_TESTBED"
+fi
+
+# written next to the loaded one and renamed over it, so the host never sees half a file
+build_game_module() {
+    $CXX $CXXFLAGS -fPIC -shared -Isrc/game src/game/Project256.cpp -o out/libProject256.so.new
+    mv out/libProject256.so.new out/libProject256.so
+}
+
+if [ -n "$GAME_MODULE_ONLY" ]; then
+    build_game_module
+    exit 0
+fi
+
+rm -rf ./out
+mkdir out
+
+$CXX $CXXFLAGS -Isrc/game \
+    src/platform_linux/HeadlessMain.cpp \
+    src/platform_linux/GameState.cpp \
+    src/platform_linux/AudioRenderer.cpp \
+    src/platform_linux/PerfCounters.cpp \
+    src/game/Project256.cpp \
+    src/game/Profiling/Timings.cpp \
+    -o out/Project256Headless
+
+build_game_module
+$CXX $CXXFLAGS -DGAME_HOT_RELOAD -Isrc/game \
+    src/platform_linux/HeadlessMain.cpp \
+    src/platform_linux/GameState.cpp \
+    src/platform_linux/AudioRenderer.cpp \
+    src/platform_linux/PerfCounters.cpp \
+    src/platform_linux/GameModule.cpp \
+    src/game/Profiling/Timings.cpp \
+    -ldl -o out/Project256HeadlessReload
+
+# the tests run with the debug checks on
+$CXX $CXXFLAGS -DARENA_POISON=1 -Isrc/tests src/tests/TestsMain.cpp src/game/Profiling/Timings.cpp -o out/TestProject256
+
+cp assets/* out/
@@ -8,6 +8,7 @@
 #pragma once
 #include <array>
 #include <cstdint>
+#include <cstring>
 
 namespace Audio {
 
@@ -25,7 +26,7 @@ struct Wave {
     std::array<Frame, FrameCount> frames;
 
     void clear() {
-        memset(frames.data(), 0, sizeof(Frame) * FrameCount);
+        std::memset(frames.data(), 0, sizeof(Frame) * FrameCount);
     }
 };
 
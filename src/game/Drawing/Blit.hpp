@@ -0,0 +1,175 @@
+//
+//  Blit.hpp
+//  Project256
+//
+//  Copies a row of 8 bit color indices over another, leaving out the pixels that
+//  have the transparent index. Every kernel compares a block of source pixels
+//  against the transparent index at once and blends the block into the
+//  destination through the resulting mask, so there is no branch per pixel.
+//  The destination block is written back whole, transparent pixels included.
+//
+
+#pragma once
+
+#include "../defines.h"
+#include "../Utility/CpuFeatures.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define P256_NEON 1
+#include <arm_neon.h>
+#else
+#define P256_NEON 0
+#endif
+
+namespace Blit {
+
+enum class Kernel : uint8_t {
+    // 8 pixels per 64 bit word
+    Swar,
+    // 16 pixels per step
+    SSE2,
+    // 32 pixels per step
+    AVX2,
+    // 16 pixels per step
+    NEON,
+    Count
+};
+
+compiletime size_t KernelCount = static_cast<size_t>(Kernel::Count);
+
+constexpr const char* kernelName(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::Swar: return "Swar";
+        case Kernel::SSE2: return "SSE2";
+        case Kernel::AVX2: return "AVX2";
+        case Kernel::NEON: return "NEON";
+        default: return "?";
+    }
+}
+
+inline bool isSupported(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::Swar: return true;
+        // part of every x86-64
+        case Kernel::SSE2: return P256_X86 && sizeof(void*) == 8;
+        case Kernel::AVX2: return CpuFeatures::hasAvx2();
+        case Kernel::NEON: return P256_NEON;
+        default: return false;
+    }
+}
+
+// the widest kernel the host has, asked once
+inline Kernel bestKernel() {
+    localpersist const Kernel best = isSupported(Kernel::AVX2) ? Kernel::AVX2
+        : isSupported(Kernel::SSE2) ? Kernel::SSE2
+        : isSupported(Kernel::NEON) ? Kernel::NEON
+        : Kernel::Swar;
+    return best;
+}
+
+inline void transparentRowScalar(const uint8_t* source, uint8_t* destination, size_t count, uint8_t transparent) {
+    for (size_t i = 0; i < count; ++i) {
+        destination[i] = source[i] != transparent ? source[i] : destination[i];
+    }
+}
+
+inline void transparentRowSwar(const uint8_t* source, uint8_t* destination, size_t count, uint8_t transparent) {
+    constexpr uint64_t Low7 = 0x7f7f7f7f7f7f7f7full;
+    constexpr uint64_t High = 0x8080808080808080ull;
+    const uint64_t key = 0x0101010101010101ull * transparent;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint64_t from, to;
+        std::memcpy(&from, source + i, 8);
+        std::memcpy(&to, destination + i, 8);
+        // the top bit of every byte that differs from the key, exact because no carry crosses a byte
+        const uint64_t difference = from ^ key;
+        const uint64_t opaque = (((difference & Low7) + Low7) | difference) & High;
+        const uint64_t mask = (opaque >> 7) * 0xff;
+        to = (to & ~mask) | (from & mask);
+        std::memcpy(destination + i, &to, 8);
+    }
+    transparentRowScalar(source + i, destination + i, count - i, transparent);
+}
+
+#if P256_X86
+
+P256_TARGET("sse2")
+inline void transparentRowSSE2(const uint8_t* source, uint8_t* destination, size_t count, uint8_t transparent) {
+    const __m128i key = _mm_set1_epi8(static_cast<char>(transparent));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i from = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        const __m128i to = _mm_loadu_si128(reinterpret_cast<const __m128i*>(destination + i));
+        const __m128i isTransparent = _mm_cmpeq_epi8(from, key);
+        const __m128i blended = _mm_or_si128(_mm_and_si128(isTransparent, to), _mm_andnot_si128(isTransparent, from));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), blended);
+    }
+    transparentRowSwar(source + i, destination + i, count - i, transparent);
+}
+
+P256_TARGET("avx2")
+inline void transparentRowAVX2(const uint8_t* source, uint8_t* destination, size_t count, uint8_t transparent) {
+    const __m256i key = _mm256_set1_epi8(static_cast<char>(transparent));
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        const __m256i from = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+        const __m256i to = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(destination + i));
+        const __m256i isTransparent = _mm256_cmpeq_epi8(from, key);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), _mm256_blendv_epi8(from, to, isTransparent));
+    }
+    transparentRowSSE2(source + i, destination + i, count - i, transparent);
+}
+
+#endif
+
+#if P256_NEON
+
+inline void transparentRowNEON(const uint8_t* source, uint8_t* destination, size_t count, uint8_t transparent) {
+    const uint8x16_t key = vdupq_n_u8(transparent);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const uint8x16_t from = vld1q_u8(source + i);
+        const uint8x16_t to = vld1q_u8(destination + i);
+        const uint8x16_t isTransparent = vceqq_u8(from, key);
+        vst1q_u8(destination + i, vbslq_u8(isTransparent, to, from));
+    }
+    transparentRowSwar(source + i, destination + i, count - i, transparent);
+}
+
+#endif
+
+// the caller checks isSupported() first, bestKernel() always is
+inline void transparentRow(Kernel kernel, const uint8_t* source, uint8_t* destination, size_t count, uint8_t transparent) {
+    switch (kernel) {
+#if P256_X86
+        case Kernel::SSE2: transparentRowSSE2(source, destination, count, transparent); return;
+        case Kernel::AVX2: transparentRowAVX2(source, destination, count, transparent); return;
+#endif
+#if P256_NEON
+        case Kernel::NEON: transparentRowNEON(source, destination, count, transparent); return;
+#endif
+        default: transparentRowSwar(source, destination, count, transparent); return;
+    }
+}
+
+// Any pixel type, with the kernels for 8 bit indices. Source and destination must not overlap.
+template <typename SourcePixel, typename Pixel>
+void transparentRow(const SourcePixel* source, Pixel* destination, size_t count, SourcePixel transparent) {
+    if constexpr (sizeof(SourcePixel) == 1 && sizeof(Pixel) == 1 && std::is_integral_v<SourcePixel> && std::is_integral_v<Pixel>) {
+        transparentRow(bestKernel(), reinterpret_cast<const uint8_t*>(source), reinterpret_cast<uint8_t*>(destination),
+                       count, static_cast<uint8_t>(transparent));
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            if (source[i] != transparent) {
+                destination[i] = static_cast<Pixel>(source[i]);
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,127 @@
+//
+//  DirtyRows.hpp
+//  Project256
+//
+//  Which rows of an image changed, as one bit per row. Cheap enough to mark on
+//  every write, and walked as spans of consecutive rows so the palette expansion
+//  and the platform texture upload only touch what changed.
+//
+
+#pragma once
+
+#include "../defines.h"
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+template <size_t Height>
+struct DirtyRows {
+    compiletime size_t RowCount = Height;
+    compiletime size_t WordBits = 64;
+    compiletime size_t WordCount = (Height + WordBits - 1) / WordBits;
+
+    std::array<uint64_t, WordCount> words;
+
+    constexpr void clear() {
+        words.fill(0);
+    }
+
+    constexpr void mark(size_t row) {
+        if (row < Height) {
+            words[row / WordBits] |= uint64_t{1} << (row % WordBits);
+        }
+    }
+
+    // marks count rows starting at first, clipped to the image
+    constexpr void mark(size_t first, size_t count) {
+        const size_t end = first + count < Height ? first + count : Height;
+        for (size_t row = first; row < end; ++row) {
+            mark(row);
+        }
+    }
+
+    constexpr void markAll() {
+        mark(0, Height);
+    }
+
+    constexpr bool test(size_t row) const {
+        return row < Height && (words[row / WordBits] >> (row % WordBits) & 1);
+    }
+
+    constexpr bool any() const {
+        for (uint64_t word : words) {
+            if (word) return true;
+        }
+        return false;
+    }
+
+    constexpr size_t count() const {
+        size_t result = 0;
+        for (uint64_t word : words) {
+            result += static_cast<size_t>(std::popcount(word));
+        }
+        return result;
+    }
+
+    constexpr DirtyRows& operator|=(const DirtyRows& other) {
+        for (size_t i = 0; i < WordCount; ++i) {
+            words[i] |= other.words[i];
+        }
+        return *this;
+    }
+
+    // calls f(firstRow, rowCount) for each run of consecutive dirty rows, top to bottom in memory
+    template <typename F>
+    constexpr void forEachSpan(F&& f) const {
+        size_t row = 0;
+        while (row < Height) {
+            const uint64_t word = words[row / WordBits] >> (row % WordBits);
+            if (word == 0) {
+                row = (row / WordBits + 1) * WordBits;
+                continue;
+            }
+            row += static_cast<size_t>(std::countr_zero(word));
+            if (row >= Height) break;
+            const size_t first = row;
+            while (row < Height && test(row)) {
+                ++row;
+            }
+            f(first, row - first);
+        }
+    }
+
+    constexpr size_t spanCount() const {
+        size_t result = 0;
+        forEachSpan([&](size_t, size_t) { ++result; });
+        return result;
+    }
+};
+
+// The dirty rows of the last few published frames, each relative to the one before.
+// Travels inside the frame, so a consumer that skipped frames can still work out
+// everything that changed since the frame it saw last.
+template <size_t Height, size_t Depth = 8>
+struct DirtyRowsHistory {
+    // serial of the newest entry, 0 means nothing was pushed yet
+    uint64_t serial;
+    std::array<DirtyRows<Height>, Depth> entries;
+
+    constexpr void push(const DirtyRows<Height>& rows) {
+        ++serial;
+        entries[serial % Depth] = rows;
+    }
+
+    // rows that changed after the frame with serial seen, everything if that frame is too old to tell
+    constexpr DirtyRows<Height> since(uint64_t seen) const {
+        DirtyRows<Height> result{};
+        if (seen == 0 || seen > serial || serial - seen >= Depth) {
+            result.markAll();
+            return result;
+        }
+        for (uint64_t s = seen + 1; s <= serial; ++s) {
+            result |= entries[s % Depth];
+        }
+        return result;
+    }
+};
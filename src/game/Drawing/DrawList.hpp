@@ -0,0 +1,236 @@
+//
+//  DrawList.hpp
+//  Project256
+//
+//  Draws collected during a tick and done in one pass at its end. Every draw
+//  copies a rectangle out of one page of an atlas, a set of same-sized images,
+//  to a position in the destination, opaque or leaving out a transparent color.
+//
+//  Before any pixel is touched, draws that end up entirely outside the
+//  destination are dropped. The rest are sorted by layer, then by page, so
+//  draws from one page follow each other while it is still in the cache.
+//  Inside a layer and page they keep the order they were added in. Lower
+//  layers are drawn first.
+//
+//  The commands live in an arena, usually the frame arena, so a list is set
+//  up again every tick.
+//
+//  executeTiled() bins the same draws into square tiles of the destination
+//  and lets a WorkerPool draw the tiles in parallel.
+//
+
+#pragma once
+
+#include "../defines.h"
+#include "../Math/Vec2Math.hpp"
+#include "../Utility/Arena.hpp"
+#include "../Utility/WorkerPool.hpp"
+#include "Images.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <span>
+
+template <anImage Atlas>
+struct DrawList {
+    using Pixel = typename Atlas::PixelType;
+
+    struct Command {
+        // layer, page and the order of adding, lower draws first
+        uint64_t sortKey;
+        // lower corner of the rectangle in the page, in its storage order like makeSubImage
+        Vec2i source;
+        Vec2i size;
+        Vec2i position;
+        Pixel transparentColor;
+        bool isOpaque;
+    };
+
+    Command* commands;
+    uint32_t capacity;
+    uint32_t count;
+    // draws that did not fit since init, and draws the last execute() dropped as off screen or
+    // out of their page
+    uint32_t overflowCount;
+    uint32_t culledCount;
+
+    // false when the arena has no room for capacity commands
+    bool init(Arena& arena, uint32_t commandCapacity) {
+        commands = arena.allocateArray<Command>(commandCapacity);
+        capacity = commands ? commandCapacity : 0;
+        count = overflowCount = culledCount = 0;
+        return commands != nullptr;
+    }
+
+    compiletime uint64_t makeSortKey(int16_t layer, uint16_t page, uint32_t sequence) {
+        // the layer shifted to unsigned keeps negative layers below the positive ones
+        const uint64_t biasedLayer = static_cast<uint16_t>(layer ^ INT16_MIN);
+        return biasedLayer << 48 | uint64_t{page} << 32 | sequence;
+    }
+
+    compiletime uint16_t pageOf(const Command& command) {
+        return static_cast<uint16_t>(command.sortKey >> 32);
+    }
+
+    // source and size pick the rectangle out of page; false when the list is full
+    bool add(int16_t layer, uint16_t page, Vec2i source, Vec2i size, Vec2i position) {
+        return push(layer, page, source, size, position, Pixel{}, true);
+    }
+
+    bool addTransparent(int16_t layer, uint16_t page, Vec2i source, Vec2i size, Vec2i position, Pixel transparentColor) {
+        return push(layer, page, source, size, position, transparentColor, false);
+    }
+
+    // a region made with makeSubImage out of the page
+    template <typename View>
+    bool add(int16_t layer, uint16_t page, const View& region, Vec2i position) {
+        return add(layer, page, regionOrigin(region), regionSize(region), position);
+    }
+
+    template <typename View>
+    bool addTransparent(int16_t layer, uint16_t page, const View& region, Vec2i position, Pixel transparentColor) {
+        return addTransparent(layer, page, regionOrigin(region), regionSize(region), position, transparentColor);
+    }
+
+    // Culls, sorts and draws everything into destination, then empties the list.
+    template <anImage U>
+    void execute(std::span<const Atlas> pages, U& destination) {
+        const Command* end = cullAndSort(pages, imageSize(destination));
+        for (const Command* command = commands; command != end; ++command) {
+            draw(*command, pages, destination, Vec2i{});
+        }
+        count = 0;
+    }
+
+    // Like execute(), with the destination cut into TileSize squares that the workers draw in
+    // parallel. Each tile gets the draws that touch it, in the same order execute() draws them,
+    // and only writes its own pixels, so no tile waits on another. The bins come out of
+    // scratch; if it has no room, everything is drawn on the caller instead.
+    template <int TileSize = 32, anImage U>
+    void executeTiled(std::span<const Atlas> pages, U& destination, WorkerPool& workers, Arena& scratch) {
+        static_assert(TileSize > 0);
+        const Vec2i size = imageSize(destination);
+        const Command* end = cullAndSort(pages, size);
+        const uint32_t drawCount = static_cast<uint32_t>(end - commands);
+        const Vec2i tiles = (size + Vec2i{TileSize - 1, TileSize - 1}) / TileSize;
+        const size_t tileCount = static_cast<size_t>(tiles.x) * static_cast<size_t>(tiles.y);
+
+        const auto tileRange = [&](const Command& command, Vec2i& first, Vec2i& last) {
+            first = max(command.position, Vec2i{}) / TileSize;
+            last = (min(command.position + command.size, size) - Vec2i{1, 1}) / TileSize;
+        };
+
+        const Arena::Marker marker = scratch.mark();
+        // first[tile] to first[tile + 1] index the tile's draws, counted first and then filled in
+        uint32_t* first = scratch.allocateArray<uint32_t>(tileCount + 1);
+        uint32_t entryCount = 0;
+        if (first) {
+            std::fill_n(first, tileCount + 1, 0u);
+            for (const Command* command = commands; command != end; ++command) {
+                Vec2i low, high;
+                tileRange(*command, low, high);
+                for (int y = low.y; y <= high.y; ++y) {
+                    for (int x = low.x; x <= high.x; ++x) {
+                        ++first[y * tiles.x + x + 1];
+                    }
+                }
+            }
+            for (size_t tile = 0; tile < tileCount; ++tile) {
+                first[tile + 1] += first[tile];
+            }
+            entryCount = first[tileCount];
+        }
+        uint32_t* entries = first ? scratch.allocateArray<uint32_t>(entryCount) : nullptr;
+        uint32_t* filled = entries ? scratch.allocateArray<uint32_t>(tileCount) : nullptr;
+        if (!filled) {
+            scratch.rewind(marker);
+            for (const Command* command = commands; command != end; ++command) {
+                draw(*command, pages, destination, Vec2i{});
+            }
+            count = 0;
+            return;
+        }
+
+        std::copy_n(first, tileCount, filled);
+        for (uint32_t index = 0; index < drawCount; ++index) {
+            Vec2i low, high;
+            tileRange(commands[index], low, high);
+            for (int y = low.y; y <= high.y; ++y) {
+                for (int x = low.x; x <= high.x; ++x) {
+                    entries[filled[y * tiles.x + x]++] = index;
+                }
+            }
+        }
+
+        workers.run(tileCount, [&](size_t tile) {
+            const Vec2i corner = TileSize * Vec2i{ static_cast<int>(tile % tiles.x), static_cast<int>(tile / tiles.x) };
+            const Vec2i extent = min(corner + Vec2i{TileSize, TileSize}, size) - corner;
+            auto target = makeSubImage(destination, corner.x, corner.y, static_cast<size_t>(extent.x), static_cast<size_t>(extent.y));
+            for (uint32_t entry = first[tile]; entry < first[tile + 1]; ++entry) {
+                draw(commands[entries[entry]], pages, target, corner);
+            }
+        });
+        scratch.rewind(marker);
+        count = 0;
+    }
+
+private:
+    bool push(int16_t layer, uint16_t page, Vec2i source, Vec2i size, Vec2i position, Pixel transparentColor, bool isOpaque) {
+        if (count == capacity) {
+            ++overflowCount;
+            return false;
+        }
+        if (!(Vec2i{} < size))
+            return true;
+        commands[count] = Command{
+            .sortKey = makeSortKey(layer, page, count),
+            .source = source,
+            .size = size,
+            .position = position,
+            .transparentColor = transparentColor,
+            .isOpaque = isOpaque,
+        };
+        ++count;
+        return true;
+    }
+
+    template <anImage U>
+    static Vec2i imageSize(const U& image) {
+        return Vec2i{ static_cast<int>(image.width()), static_cast<int>(image.height()) };
+    }
+
+    // Drops what is off screen, on a missing page or reaching out of its page to the back and
+    // sorts the rest, returns their end. Nothing after this reads outside a page.
+    Command* cullAndSort(std::span<const Atlas> pages, Vec2i destinationSize) {
+        const auto isOnScreen = [&](const Command& command) {
+            return Vec2i{} < command.position + command.size && command.position < destinationSize
+                && pageOf(command) < pages.size()
+                && Vec2i{} <= command.source && command.source + command.size <= imageSize(pages[pageOf(command)]);
+        };
+        Command* end = std::partition(commands, commands + count, isOnScreen);
+        culledCount = static_cast<uint32_t>(commands + count - end);
+        std::sort(commands, end, [](const Command& a, const Command& b) { return a.sortKey < b.sortKey; });
+        return end;
+    }
+
+    // destination starts at offset in the image the command's position is in
+    template <typename U>
+    static void draw(const Command& command, std::span<const Atlas> pages, U&& destination, Vec2i offset) {
+        const auto region = makeSubImage(pages[pageOf(command)], command.source.x, command.source.y,
+                                         static_cast<size_t>(command.size.x), static_cast<size_t>(command.size.y));
+        if (command.isOpaque) {
+            imageCopy(region, destination, command.position - offset);
+        } else {
+            imageBlitWithTransparentColor(region, destination, command.position - offset, command.transparentColor);
+        }
+    }
+
+    template <typename View>
+    static Vec2i regionOrigin(const View& region) {
+        return Vec2i{ static_cast<int>(region.originX()), static_cast<int>(region.originY()) };
+    }
+
+    template <typename View>
+    static Vec2i regionSize(const View& region) {
+        return Vec2i{ static_cast<int>(region.width()), static_cast<int>(region.height()) };
+    }
+};
@@ -169,9 +169,9 @@ struct Line {
 
     constexpr size_t size() const {
         if (mSteep) {
-            return abs(static_cast<int64_t>(mTo.y) - mFrom.y) + 1;
+            return myabs(static_cast<int64_t>(mTo.y) - mFrom.y) + 1;
         } else {
-            return abs(static_cast<int64_t>(mTo.x) - mFrom.x) + 1;
+            return myabs(static_cast<int64_t>(mTo.x) - mFrom.x) + 1;
         }
     }
 };
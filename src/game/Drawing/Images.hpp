@@ -7,7 +7,15 @@
 
 #pragma once
 
+#include "../defines.h"
+#include "../Math/Vec2Math.hpp"
+#include "../FML/RangesAtHome.hpp"
+#include "Blit.hpp"
+#include <algorithm>
+#include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <type_traits>
 #include <array>
 #include <span>
@@ -37,7 +45,7 @@ concept anImage = requires(T& t) {
     { t.pitch() } -> std::convertible_to<size_t>;
     { t.originX() } -> std::convertible_to<ptrdiff_t>;
     { t.originY()} -> std::convertible_to<ptrdiff_t>;
-    { t.at(Vec2i{}) } -> std::same_as<std::add_lvalue_reference_t<typename std::decay_t<T>::PixelType>>;
+    { t.at(Vec2i{}) } -> std::convertible_to<const typename std::decay_t<T>::PixelType&>;
 };
 
 template <typename T, typename U>
@@ -50,6 +58,10 @@ concept aStaticImage = anImage<T> && requires(T& t) {
     { T::LineOrder } -> std::convertible_to<ImageLineOrder>;
 };
 
+// an Image whose lines follow each other without a gap, so its visible pixels are one array
+template <typename T>
+concept aContiguousImage = aStaticImage<T> && (std::decay_t<T>::ImagePitch == std::decay_t<T>::ImageWidth);
+
 template <typename T, size_t Width, size_t Height, ImageOrigin O = ImageOrigin::BottomLeft, size_t Pitch = Width>
 struct Image {
 
@@ -63,6 +75,9 @@ struct Image {
     constant ImageOrigin Origin = O;
     constant ImageLineOrder LineOrder = (Origin == ImageOrigin::BottomLeft ? ImageLineOrder::BottomToTop : ImageLineOrder::TopToBottom);
 
+    constant size_t ImageWidth = Width;
+    constant size_t ImageHeight = Height;
+    constant size_t ImagePitch = Pitch;
     constant size_t VisiblePixelCount = Width * Height;
     constant size_t StoragePixelCount = Pitch * Height;
 
@@ -112,6 +127,11 @@ struct Image {
             LinesIterator endLine;
             using LineSpan = typename LinesIterator::LineSpan;
             using LineSpanIterator = typename LineSpan::iterator;
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = std::remove_cv_t<PixelType>;
+            using difference_type = std::ptrdiff_t;
+            using pointer = PixelType*;
+            using reference = PixelType&;
 
             LineSpanIterator pos;
             LineSpanIterator end;
@@ -140,6 +160,10 @@ struct Image {
             constexpr bool operator!=(const Iterator& other) const {
                 return line != other.line;
             }
+
+            constexpr bool operator==(const Iterator& other) const {
+                return !(line != other.line);
+            }
         };
 
         Iterator begin() {
@@ -185,6 +209,10 @@ struct Image {
         return lines.front().data();
     }
 
+    constexpr const PixelType* data() const {
+        return lines.front().data();
+    }
+
     constexpr auto pixels() {
         return PixelsView{linesView()};
     }
@@ -197,9 +225,60 @@ struct Image {
         return reinterpret_cast<uint8_t*>(data());
     }
 
+    // all visible pixels, in storage order
+    constexpr std::span<PixelType, VisiblePixelCount> contiguousPixels() requires (Pitch == Width) {
+        return std::span<PixelType, VisiblePixelCount>{ data(), VisiblePixelCount };
+    }
+
+    constexpr std::span<const PixelType, VisiblePixelCount> contiguousPixels() const requires (Pitch == Width) {
+        return std::span<const PixelType, VisiblePixelCount>{ data(), VisiblePixelCount };
+    }
+
+    // Calls function with every visible pixel in storage order. One loop over all of them
+    // when the lines have no gap in between, one per line when they have.
+    template <typename Function>
+    constexpr void forEachPixel(Function&& function) {
+        if constexpr (Pitch == Width) {
+            for (PixelType& pixel : contiguousPixels()) {
+                function(pixel);
+            }
+        } else {
+            for (auto& line : lines) {
+                for (size_t x = 0; x < Width; ++x) {
+                    function(line[x]);
+                }
+            }
+        }
+    }
+
+    template <typename Function>
+    constexpr void forEachPixel(Function&& function) const {
+        if constexpr (Pitch == Width) {
+            for (const PixelType& pixel : contiguousPixels()) {
+                function(pixel);
+            }
+        } else {
+            for (const auto& line : lines) {
+                for (size_t x = 0; x < Width; ++x) {
+                    function(line[x]);
+                }
+            }
+        }
+    }
+
+    // replaces every visible pixel with function(pixel)
+    template <typename Function>
+    constexpr void transformPixels(Function&& function) {
+        forEachPixel([&](PixelType& pixel) { pixel = function(static_cast<const PixelType&>(pixel)); });
+    }
+
     constexpr void fill(const PixelType& pixelValue) {
-        for(PixelType& p : pixels()) {
-            p = pixelValue;
+        if constexpr (Pitch == Width) {
+            std::fill_n(data(), VisiblePixelCount, pixelValue);
+        } else {
+            for (auto& line : lines) {
+                std::fill_n(line.data(), Width, pixelValue);
+            }
         }
     }
 
@@ -285,8 +364,9 @@ struct Image {
 
 template <typename TImage, ImageOrigin O = ImageOrigin::BottomLeft>
 struct SubImageView {
-    using ImageType = std::decay_t<TImage>;
-    using Pixel = typename ImageType::PixelType;
+    // const when the view is made of a const image, which then only reads through a const view
+    using ImageType = std::remove_reference_t<TImage>;
+    using Pixel = typename std::decay_t<TImage>::PixelType;
     template <typename T = Pixel>
     struct Line {
         using PixelType = T;
@@ -363,7 +443,11 @@ struct SubImageView {
     ptrdiff_t mOriginX, mOriginY;
 
     constexpr Pixel* data() {
-        return &at(0,0);
+        return image.data() + mOriginX + mOriginY * image.pitch();
+    }
+
+    constexpr const Pixel* data() const {
+        return image.data() + mOriginX + mOriginY * image.pitch();
     }
 
     constexpr size_t size() const {
@@ -417,7 +501,7 @@ struct SubImageView {
     }
 
     constexpr size_t pitch() const {
-        return image.pitch;
+        return image.pitch();
     }
 
     constexpr ptrdiff_t originX() const {
@@ -517,6 +601,16 @@ requires(std::same_as<typename T::PixelType, typename U::PixelType>)
 constexpr void imageCopy(const T& source, U& destination) {
     using DestinationType = std::decay_t<U>;
     using Pixel = typename DestinationType::PixelType;
+
+    // same lines in the same order without gaps: one copy of all of them
+    if constexpr (aContiguousImage<T> && aContiguousImage<U>) {
+        if constexpr (T::LineOrder == DestinationType::LineOrder && T::ImageWidth == DestinationType::ImageWidth) {
+            const size_t lineCount = std::min(T::ImageHeight, DestinationType::ImageHeight);
+            std::memcpy(destination.data(), source.data(), lineCount * T::ImageWidth * sizeof(Pixel));
+            return;
+        }
+    }
+
     auto sourceLines = source.template linesView<DestinationType::LineOrder>();
     auto destinationLines = destination.linesView();
     const size_t lineByteCount = std::min(source.width(), destination.width()) * sizeof(Pixel);
@@ -525,32 +619,77 @@ constexpr void imageCopy(const T& source, U& destination) {
     {
         const Pixel* from = src.data();
         Pixel* to = dst.data();
-        memcpy(to, from, lineByteCount);
+        std::memcpy(to, from, lineByteCount);
     }
 }
 
+// The whole source at position in the destination, clipped like the positioned transparent blit below.
 template <anImage T, anImage U>
-constexpr void imageBlitWithTransparentColor(const T& source, U&& destination, typename T::PixelType transparentColor) {
+requires(std::same_as<typename std::decay_t<T>::PixelType, typename std::decay_t<U>::PixelType>)
+constexpr void imageCopy(const T& source, U&& destination, Vec2i position) {
     using DestinationType = std::decay_t<U>;
-    using SourceType = std::decay_t<T>;
-    using SrcPixel = typename SourceType::PixelType;
     using Pixel = typename DestinationType::PixelType;
+    const ptrdiff_t sourceWidth = static_cast<ptrdiff_t>(source.width());
+    const ptrdiff_t sourceHeight = static_cast<ptrdiff_t>(source.height());
+    const ptrdiff_t left = std::max<ptrdiff_t>(0, -position.x);
+    const ptrdiff_t right = std::min<ptrdiff_t>(sourceWidth, static_cast<ptrdiff_t>(destination.width()) - position.x);
+    const ptrdiff_t top = std::max<ptrdiff_t>(0, -position.y);
+    const ptrdiff_t bottom = std::min<ptrdiff_t>(sourceHeight, static_cast<ptrdiff_t>(destination.height()) - position.y);
+    if (left >= right || top >= bottom)
+        return;
+
+    const bool flipped = source.lineOrder() != DestinationType::LineOrder;
+    const ptrdiff_t sourcePitch = static_cast<ptrdiff_t>(source.pitch());
+    const ptrdiff_t destinationPitch = static_cast<ptrdiff_t>(destination.pitch());
+    for (ptrdiff_t y = top; y < bottom; ++y) {
+        const ptrdiff_t sourceLine = flipped ? sourceHeight - 1 - y : y;
+        std::memcpy(destination.data() + (position.y + y) * destinationPitch + position.x + left,
+                    source.data() + sourceLine * sourcePitch + left,
+                    static_cast<size_t>(right - left) * sizeof(Pixel));
+    }
+}
+
+// Source over destination, lines in the destination's order, left out where the source has the
+// transparent color. Covers the width and height the two have in common.
+template <anImage T, anImage U>
+constexpr void imageBlitWithTransparentColor(const T& source, U&& destination, typename std::decay_t<T>::PixelType transparentColor) {
+    using DestinationType = std::decay_t<U>;
     auto sourceLines = source.template lines<DestinationType::LineOrder>();
     auto destinationLines = destination.lines();
 
-    const size_t lineWidth = std::min(sourceLines.length(), destinationLines.length()) * sizeof(Pixel);
+    const size_t width = std::min(sourceLines.length(), destinationLines.length());
     auto src = sourceLines.begin();
     auto srcEnd = sourceLines.end();
     auto dst = destinationLines.begin();
     auto dstEnd = destinationLines.end();
 
     while (src != srcEnd && dst != dstEnd) {
-        for (size_t i = 0; i < lineWidth; ++i) {
-            SrcPixel srcColor = (*src).pixel(i);
-            if (srcColor != transparentColor)
-                (*dst).pixel(i) = static_cast<Pixel>(srcColor);
-        }
+        Blit::transparentRow((*src).begin(), (*dst).begin(), width, transparentColor);
         ++src; ++dst;
     }
 }
 
+// The whole source at position in the destination, clipped to the destination on every side.
+// The source's lines go in the destination's order, flipped if the two images differ in it.
+template <anImage T, anImage U>
+constexpr void imageBlitWithTransparentColor(const T& source, U&& destination, Vec2i position, typename std::decay_t<T>::PixelType transparentColor) {
+    using DestinationType = std::decay_t<U>;
+    const ptrdiff_t sourceWidth = static_cast<ptrdiff_t>(source.width());
+    const ptrdiff_t sourceHeight = static_cast<ptrdiff_t>(source.height());
+    const ptrdiff_t left = std::max<ptrdiff_t>(0, -position.x);
+    const ptrdiff_t right = std::min<ptrdiff_t>(sourceWidth, static_cast<ptrdiff_t>(destination.width()) - position.x);
+    const ptrdiff_t top = std::max<ptrdiff_t>(0, -position.y);
+    const ptrdiff_t bottom = std::min<ptrdiff_t>(sourceHeight, static_cast<ptrdiff_t>(destination.height()) - position.y);
+    if (left >= right || top >= bottom)
+        return;
+
+    const bool flipped = source.lineOrder() != DestinationType::LineOrder;
+    const ptrdiff_t sourcePitch = static_cast<ptrdiff_t>(source.pitch());
+    const ptrdiff_t destinationPitch = static_cast<ptrdiff_t>(destination.pitch());
+    for (ptrdiff_t y = top; y < bottom; ++y) {
+        const ptrdiff_t sourceLine = flipped ? sourceHeight - 1 - y : y;
+        Blit::transparentRow(source.data() + sourceLine * sourcePitch + left,
+                             destination.data() + (position.y + y) * destinationPitch + position.x + left,
+                             static_cast<size_t>(right - left), transparentColor);
+    }
+}
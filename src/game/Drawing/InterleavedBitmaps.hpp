@@ -10,6 +10,7 @@
 #pragma once
 
 #include "../defines.h"
+#include "../Profiling/Zones.hpp"
 #include <cstdint>
 #include <cassert>
 #include <optional>
@@ -341,6 +342,7 @@ struct ILBMDataParser {
     }
 
     void inflateAndDeinterleaveInto(uint8_t* buffer, size_t bufferSize, size_t bufferPitch) {
+        PROFILE_ZONE("ILBM inflate");
         auto header = this->getHeader();
         assert(header.compression == ILBMCompression::ByteRun1);
 
@@ -0,0 +1,305 @@
+//
+//  PaletteExpansion.hpp
+//  Project256
+//
+//  Turns 8 bit color indices into 32 bit ARGB pixels. There are several kernels
+//  for this, which one is fastest depends on the host and the palette, so the
+//  Expander measures them once before the first frame, for small and for full palettes, and
+//  uses the winner for whatever palette it is given.
+//
+//  The Expander belongs to the draw side and stays out of the game memory block:
+//  its tables are half a megabyte the game never reads, and a kernel picked by
+//  timing would make a replay of the same input differ in memory.
+//
+
+#pragma once
+
+#include "../defines.h"
+#include "../Utility/CpuFeatures.hpp"
+#include "../Utility/WorkerPool.hpp"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+
+namespace PaletteExpansion {
+
+enum class Kernel : uint8_t {
+    // 8 table loads per 64 bit word
+    Scalar,
+    // 64K entry table, one load for every two pixels
+    PairLut,
+    // byte shuffles on the 4 byte planes of the first 16 colors, palettes of 16 colors or fewer only
+    Nibble_SSSE3,
+    // 8 table loads per gather instruction
+    Gather_AVX2,
+    Count
+};
+
+compiletime size_t KernelCount = static_cast<size_t>(Kernel::Count);
+
+// below this many pixels waking another thread costs more than expanding them,
+// a full 320x200 frame is worth three threads
+compiletime size_t MinPixelsPerThread = 16 * 1024;
+
+constexpr const char* kernelName(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::Scalar: return "Scalar";
+        case Kernel::PairLut: return "PairLut";
+        case Kernel::Nibble_SSSE3: return "Nibble_SSSE3";
+        case Kernel::Gather_AVX2: return "Gather_AVX2";
+        default: return "?";
+    }
+}
+
+struct Tables {
+    std::array<uint32_t, 256> palette;
+    // number of colors in use, every index that is expanded has to be smaller than this
+    size_t colorCount;
+    // byte n of each of the first 16 colors
+    alignas(16) std::array<std::array<uint8_t, 16>, 4> planes;
+    // two pixels at once, indexed by two neighbouring source bytes in memory order,
+    // only filled in by build() when asked for
+    alignas(64) std::array<uint64_t, 256 * 256> pairs;
+    bool hasPairs;
+
+    void build(const uint32_t* newPalette, size_t newColorCount, bool withPairs = true) {
+        std::memcpy(palette.data(), newPalette, sizeof(palette));
+        colorCount = newColorCount;
+        for (size_t color = 0; color < 16; ++color) {
+            for (size_t byte = 0; byte < 4; ++byte) {
+                planes[byte][color] = static_cast<uint8_t>(palette[color] >> (8 * byte));
+            }
+        }
+        hasPairs = withPairs;
+        if (!withPairs)
+            return;
+        for (size_t second = 0; second < 256; ++second) {
+            const uint64_t high = static_cast<uint64_t>(palette[second]) << 32;
+            for (size_t first = 0; first < 256; ++first) {
+                pairs[second << 8 | first] = high | palette[first];
+            }
+        }
+    }
+};
+
+inline bool isSupported(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::Scalar:
+        case Kernel::PairLut: return true;
+        case Kernel::Nibble_SSSE3: return CpuFeatures::hasSsse3();
+        case Kernel::Gather_AVX2: return CpuFeatures::hasAvx2();
+        default: return false;
+    }
+}
+
+// supported by the host and correct for the palette
+inline bool isUsable(Kernel kernel, const Tables& tables) {
+    if (kernel == Kernel::Nibble_SSSE3 && tables.colorCount > 16)
+        return false;
+    if (kernel == Kernel::PairLut && !tables.hasPairs)
+        return false;
+    return isSupported(kernel);
+}
+
+inline void expandScalar(const Tables& tables, const uint8_t* source, uint32_t* destination, size_t count) {
+    const uint32_t* palette = tables.palette.data();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint64_t sourcePixel8;
+        std::memcpy(&sourcePixel8, source + i, 8);
+        const uint64_t pixels[4] = {
+            static_cast<uint64_t>(palette[sourcePixel8 >> 0 & 0xff]) |
+                static_cast<uint64_t>(palette[sourcePixel8 >> 8 & 0xff]) << 32,
+            static_cast<uint64_t>(palette[sourcePixel8 >> 16 & 0xff]) |
+                static_cast<uint64_t>(palette[sourcePixel8 >> 24 & 0xff]) << 32,
+            static_cast<uint64_t>(palette[sourcePixel8 >> 32 & 0xff]) |
+                static_cast<uint64_t>(palette[sourcePixel8 >> 40 & 0xff]) << 32,
+            static_cast<uint64_t>(palette[sourcePixel8 >> 48 & 0xff]) |
+                static_cast<uint64_t>(palette[sourcePixel8 >> 56 & 0xff]) << 32,
+        };
+        std::memcpy(destination + i, pixels, sizeof(pixels));
+    }
+    for (; i < count; ++i) {
+        destination[i] = palette[source[i]];
+    }
+}
+
+inline void expandPairLut(const Tables& tables, const uint8_t* source, uint32_t* destination, size_t count) {
+    const uint64_t* pairs = tables.pairs.data();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint64_t sourcePixel8;
+        std::memcpy(&sourcePixel8, source + i, 8);
+        const uint64_t pixels[4] = {
+            pairs[sourcePixel8 >> 0 & 0xffff],
+            pairs[sourcePixel8 >> 16 & 0xffff],
+            pairs[sourcePixel8 >> 32 & 0xffff],
+            pairs[sourcePixel8 >> 48 & 0xffff],
+        };
+        std::memcpy(destination + i, pixels, sizeof(pixels));
+    }
+    for (; i < count; ++i) {
+        destination[i] = tables.palette[source[i]];
+    }
+}
+
+#if P256_X86
+
+P256_TARGET("ssse3")
+inline void expandNibble(const Tables& tables, const uint8_t* source, uint32_t* destination, size_t count) {
+    const __m128i plane0 = _mm_load_si128(reinterpret_cast<const __m128i*>(tables.planes[0].data()));
+    const __m128i plane1 = _mm_load_si128(reinterpret_cast<const __m128i*>(tables.planes[1].data()));
+    const __m128i plane2 = _mm_load_si128(reinterpret_cast<const __m128i*>(tables.planes[2].data()));
+    const __m128i plane3 = _mm_load_si128(reinterpret_cast<const __m128i*>(tables.planes[3].data()));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        const __m128i byte0 = _mm_shuffle_epi8(plane0, indices);
+        const __m128i byte1 = _mm_shuffle_epi8(plane1, indices);
+        const __m128i byte2 = _mm_shuffle_epi8(plane2, indices);
+        const __m128i byte3 = _mm_shuffle_epi8(plane3, indices);
+        // interleave the planes back into whole pixels
+        const __m128i low01 = _mm_unpacklo_epi8(byte0, byte1);
+        const __m128i high01 = _mm_unpackhi_epi8(byte0, byte1);
+        const __m128i low23 = _mm_unpacklo_epi8(byte2, byte3);
+        const __m128i high23 = _mm_unpackhi_epi8(byte2, byte3);
+        __m128i* out = reinterpret_cast<__m128i*>(destination + i);
+        _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(low01, low23));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(low01, low23));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(high01, high23));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(high01, high23));
+    }
+    for (; i < count; ++i) {
+        destination[i] = tables.palette[source[i]];
+    }
+}
+
+P256_TARGET("avx2")
+inline void expandGather(const Tables& tables, const uint8_t* source, uint32_t* destination, size_t count) {
+    const int* palette = reinterpret_cast<const int*>(tables.palette.data());
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i indices = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+        const __m256i low = _mm256_cvtepu8_epi32(indices);
+        const __m256i high = _mm256_cvtepu8_epi32(_mm_srli_si128(indices, 8));
+        __m256i* out = reinterpret_cast<__m256i*>(destination + i);
+        _mm256_storeu_si256(out + 0, _mm256_i32gather_epi32(palette, low, 4));
+        _mm256_storeu_si256(out + 1, _mm256_i32gather_epi32(palette, high, 4));
+    }
+    for (; i < count; ++i) {
+        destination[i] = tables.palette[source[i]];
+    }
+}
+
+#endif
+
+// the caller checks isUsable() first
+inline void expand(Kernel kernel, const Tables& tables, const uint8_t* source, uint32_t* destination, size_t count) {
+    switch (kernel) {
+        case Kernel::PairLut: expandPairLut(tables, source, destination, count); return;
+#if P256_X86
+        case Kernel::Nibble_SSSE3: expandNibble(tables, source, destination, count); return;
+        case Kernel::Gather_AVX2: expandGather(tables, source, destination, count); return;
+#endif
+        default: expandScalar(tables, source, destination, count); return;
+    }
+}
+
+// Times every usable kernel on the sample and returns the fastest. Writes the best
+// time of each kernel in nanoseconds per pixel to nsPerPixel if given, 0 for kernels
+// that could not run.
+inline Kernel benchmark(const Tables& tables, const uint8_t* sample, uint32_t* scratch, size_t count,
+                        int repetitions = 5, std::array<double, KernelCount>* nsPerPixel = nullptr) {
+    using Clock = std::chrono::steady_clock;
+    Kernel fastest = Kernel::Scalar;
+    double fastestTime = 0;
+    for (size_t k = 0; k < KernelCount; ++k) {
+        const auto kernel = static_cast<Kernel>(k);
+        double best = 0;
+        if (isUsable(kernel, tables) && count > 0) {
+            // the first run warms the caches and the table pages
+            expand(kernel, tables, sample, scratch, count);
+            for (int r = 0; r < repetitions; ++r) {
+                const auto start = Clock::now();
+                expand(kernel, tables, sample, scratch, count);
+                const double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+                best = (r == 0 || elapsed < best) ? elapsed : best;
+            }
+            if (k == 0 || best < fastestTime) {
+                fastest = kernel;
+                fastestTime = best;
+            }
+        }
+        if (nsPerPixel) {
+            (*nsPerPixel)[k] = best;
+        }
+    }
+    return fastest;
+}
+
+// Owned by whoever calls writeDrawBuffer, next to its workers. measure() once before the
+// first frame, prepare() rebuilds the tables whenever the palette changes, which is
+// expensive enough that palettes should not change every frame. Until measure() ran
+// every palette uses the scalar kernel.
+struct Expander {
+    Tables tables;
+    // fastest for palettes of up to 16 colors and for bigger ones
+    Kernel smallPaletteKernel;
+    Kernel fullPaletteKernel;
+    Kernel kernel;
+    bool isPrepared;
+
+    // Times the kernels on count pixels of random colors, takes a few milliseconds.
+    void measure(size_t count) {
+        auto sample = std::make_unique<uint8_t[]>(count);
+        auto scratch = std::make_unique<uint32_t[]>(count);
+        std::mt19937 random{256};
+        uint32_t palette[256];
+        for (uint32_t& color : palette) {
+            color = 0xFF000000 | (random() & 0xFFFFFF);
+        }
+        for (const size_t colorCount : {size_t{16}, size_t{256}}) {
+            for (size_t i = 0; i < count; ++i) {
+                sample[i] = static_cast<uint8_t>(random() % colorCount);
+            }
+            tables.build(palette, colorCount);
+            (colorCount == 16 ? smallPaletteKernel : fullPaletteKernel) = benchmark(tables, sample.get(), scratch.get(), count);
+        }
+        isPrepared = false;
+    }
+
+    // Returns true when the palette changed and everything needs expanding again.
+    bool prepare(const uint32_t* palette, size_t colorCount) {
+        if (isPrepared && colorCount == tables.colorCount
+            && std::memcmp(palette, tables.palette.data(), sizeof(tables.palette)) == 0) {
+            return false;
+        }
+        kernel = colorCount <= 16 ? smallPaletteKernel : fullPaletteKernel;
+        tables.build(palette, colorCount, kernel == Kernel::PairLut);
+        if (!isUsable(kernel, tables)) {
+            kernel = Kernel::Scalar;
+        }
+        isPrepared = true;
+        return true;
+    }
+
+    void operator()(const uint8_t* source, uint32_t* destination, size_t count) const {
+        expand(kernel, tables, source, destination, count);
+    }
+
+    // count rows of width pixels from row first on, in bands across the workers when there are
+    // enough pixels for it. Returns how many bands there were.
+    size_t expandRows(WorkerPool& workers, const uint8_t* source, uint32_t* destination, size_t width,
+                      size_t first, size_t count) const {
+        const size_t minRowsPerBand = MinPixelsPerThread / width;
+        return workers.forEachBand(first, count, minRowsPerBand, [&](size_t bandFirst, size_t bandCount) {
+            expand(kernel, tables, source + bandFirst * width, destination + bandFirst * width, bandCount * width);
+        });
+    }
+};
+
+}
@@ -0,0 +1,171 @@
+//
+//  RunLengthSprite.hpp
+//  Project256
+//
+//  A sprite of 8 bit color indices compiled once into the opaque runs of each
+//  row: how many transparent pixels to skip, how many opaque ones follow, and
+//  those pixels back to back. Drawing one is a memcpy per run, transparent
+//  pixels cost nothing and there is no compare per pixel left.
+//
+//  The compiled sprite lives in an arena, in the game memory like everything
+//  else, and points into it.
+//
+
+#pragma once
+
+#include "../defines.h"
+#include "../Math/Vec2Math.hpp"
+#include "../Utility/Arena.hpp"
+#include "Images.hpp"
+#include "Sprites.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+struct RunLengthSprite {
+    struct Run {
+        // transparent pixels since the end of the run before, or the start of the row
+        uint16_t skip;
+        uint16_t length;
+    };
+
+    // where a row's runs and pixels start, height + 1 of them
+    struct Row {
+        uint32_t firstRun;
+        uint32_t firstPixel;
+    };
+
+    Vec2i size;
+    const Row* rows;
+    const Run* runs;
+    const uint8_t* pixels;
+
+    bool isValid() const {
+        return rows != nullptr;
+    }
+
+    size_t runCount() const {
+        return rows ? rows[size.y].firstRun : 0;
+    }
+
+    size_t opaquePixelCount() const {
+        return rows ? rows[size.y].firstPixel : 0;
+    }
+};
+
+// Compiles width x height pixels, lines pitch pixels apart, into the arena. Invalid when the
+// arena is full or the sprite is wider than a run can say.
+inline RunLengthSprite compileRunLengthSprite(Arena& arena, const uint8_t* source, int width, int height, ptrdiff_t pitch, uint8_t transparent) {
+    RunLengthSprite sprite{ .size = { width, height } };
+    if (width <= 0 || height <= 0 || width > UINT16_MAX)
+        return sprite;
+
+    // the first pass counts, the second writes
+    size_t runCount = 0;
+    size_t pixelCount = 0;
+    for (int y = 0; y < height; ++y) {
+        const uint8_t* line = source + y * pitch;
+        for (int x = 0; x < width;) {
+            while (x < width && line[x] == transparent) ++x;
+            if (x == width) break;
+            ++runCount;
+            while (x < width && line[x] != transparent) { ++x; ++pixelCount; }
+        }
+    }
+    if (runCount > UINT32_MAX || pixelCount > UINT32_MAX)
+        return sprite;
+
+    const Arena::Marker marker = arena.mark();
+    auto* rows = arena.allocateArray<RunLengthSprite::Row>(static_cast<size_t>(height) + 1);
+    auto* runs = arena.allocateArray<RunLengthSprite::Run>(runCount);
+    auto* pixels = arena.allocateArray<uint8_t>(pixelCount);
+    if (!rows || (runCount && !runs) || (pixelCount && !pixels)) {
+        arena.rewind(marker);
+        return sprite;
+    }
+
+    uint32_t run = 0;
+    uint32_t pixel = 0;
+    for (int y = 0; y < height; ++y) {
+        rows[y] = { run, pixel };
+        const uint8_t* line = source + y * pitch;
+        int runEnd = 0;
+        for (int x = 0; x < width;) {
+            while (x < width && line[x] == transparent) ++x;
+            if (x == width) break;
+            const int start = x;
+            while (x < width && line[x] != transparent) ++x;
+            runs[run++] = { static_cast<uint16_t>(start - runEnd), static_cast<uint16_t>(x - start) };
+            std::memcpy(pixels + pixel, line + start, static_cast<size_t>(x - start));
+            pixel += static_cast<uint32_t>(x - start);
+            runEnd = x;
+        }
+    }
+    rows[height] = { run, pixel };
+
+    sprite.rows = rows;
+    sprite.runs = runs;
+    sprite.pixels = pixels;
+    return sprite;
+}
+
+template <anImage T>
+requires (sizeof(typename std::decay_t<T>::PixelType) == 1)
+RunLengthSprite compileRunLengthSprite(Arena& arena, const T& image, uint8_t transparent) {
+    return compileRunLengthSprite(arena, reinterpret_cast<const uint8_t*>(image.data()),
+                                  static_cast<int>(image.width()), static_cast<int>(image.height()),
+                                  static_cast<ptrdiff_t>(image.pitch()), transparent);
+}
+
+// one frame of a SpritePicture
+template <int W, int H, int N>
+RunLengthSprite compileRunLengthSprite(Arena& arena, const SpritePicture<W, H, N, uint8_t>& picture, int frameNumber, uint8_t transparent) {
+    return compileRunLengthSprite(arena, picture.data.data() + frameNumber * W, W, H, SpritePicture<W, H, N, uint8_t>::pixelPitch, transparent);
+}
+
+// Draws the sprite with its first row at position, rows going the way the buffer's lines are stored,
+// clipped to bufferSize.
+inline void blitRunLengthSprite(const RunLengthSprite& sprite, uint8_t* buffer, ptrdiff_t bufferPitch, Vec2i bufferSize, Vec2i position) {
+    if (!sprite.isValid())
+        return;
+    const int firstRow = std::max(0, -position.y);
+    const int endRow = std::min(sprite.size.y, bufferSize.y - position.y);
+    if (firstRow >= endRow || position.x >= bufferSize.x || position.x + sprite.size.x <= 0)
+        return;
+
+    const bool isInside = position.x >= 0 && position.x + sprite.size.x <= bufferSize.x;
+    for (int y = firstRow; y < endRow; ++y) {
+        uint8_t* line = buffer + (position.y + y) * bufferPitch;
+        const RunLengthSprite::Row row = sprite.rows[y];
+        const RunLengthSprite::Run* run = sprite.runs + row.firstRun;
+        const RunLengthSprite::Run* runEnd = sprite.runs + sprite.rows[y + 1].firstRun;
+        const uint8_t* pixels = sprite.pixels + row.firstPixel;
+        int x = position.x;
+        if (isInside) {
+            for (; run != runEnd; ++run) {
+                x += run->skip;
+                std::memcpy(line + x, pixels, run->length);
+                x += run->length;
+                pixels += run->length;
+            }
+        } else {
+            for (; run != runEnd; ++run) {
+                x += run->skip;
+                const int start = std::max(x, 0);
+                const int end = std::min(x + static_cast<int>(run->length), bufferSize.x);
+                if (start < end) {
+                    std::memcpy(line + start, pixels + (start - x), static_cast<size_t>(end - start));
+                }
+                x += run->length;
+                pixels += run->length;
+            }
+        }
+    }
+}
+
+template <anImage U>
+void blitRunLengthSprite(const RunLengthSprite& sprite, U& image, Vec2i position) {
+    static_assert(sizeof(typename std::decay_t<U>::PixelType) == 1, "run length sprites hold 8 bit indices");
+    blitRunLengthSprite(sprite, reinterpret_cast<uint8_t*>(image.data()), static_cast<ptrdiff_t>(image.pitch()),
+                        Vec2i{ static_cast<int>(image.width()), static_cast<int>(image.height()) }, position);
+}
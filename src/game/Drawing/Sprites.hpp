@@ -8,7 +8,9 @@
 
 #pragma once
 #include <cstdint>
+#include <algorithm>
 #include <array>
+#include <span>
 #include "../Drawing/Generators.hpp"
 #include "../Math/Vec2Math.hpp"
 
@@ -33,14 +35,43 @@ struct SpritePicture {
     std::array<T, W*H*N> data;
 };
 
+struct SpriteInstance {
+    int frameNumber;
+    Vec2i position;
+};
+
+// Draws a frame with its lower left corner at position, cut to the window from clipLowerLeft up to
+// but not including clipUpperRight. The window is intersected once, then whole rows are copied.
 template<typename S, typename B>
 constexpr void blitSprite(const S& spritePicture, int frameNumber, B* buffer, int bufferPixelPitch, Vec2i position, Vec2i clipLowerLeft, Vec2i clipUpperRight) {
-    for (Vec2i pos : Generators::Rectangle{Vec2i{0}, S::frameSize - Vec2i{1,1}}) {
-        Vec2i bufferPos = pos + position;
-        if (bufferPos < clipUpperRight && !(bufferPos < clipLowerLeft)) {
-            auto offset = bufferPos.x + bufferPos.y * bufferPixelPitch;
-            auto spriteOffset = frameNumber * S::frameSize.x + pos.x + pos.y * S::pixelPitch;
-            buffer[offset] = spritePicture.data[spriteOffset];
-        }
+    const Vec2i lower = max(position, clipLowerLeft);
+    const Vec2i upper = min(position + S::frameSize, clipUpperRight);
+    if (!(lower < upper))
+        return;
+
+    const int rowLength = upper.x - lower.x;
+    const auto* spriteRow = spritePicture.data.data() + frameNumber * S::frameSize.x + (lower.x - position.x) + (lower.y - position.y) * S::pixelPitch;
+    B* bufferRow = buffer + lower.x + lower.y * bufferPixelPitch;
+    for (int y = lower.y; y < upper.y; ++y) {
+        std::copy_n(spriteRow, rowLength, bufferRow);
+        spriteRow += S::pixelPitch;
+        bufferRow += bufferPixelPitch;
+    }
+}
+
+// Draws many frames of one picture. The instances are sorted by frame and then by row, so the
+// rows of one frame are read while they are still in the cache and the buffer is walked upwards.
+// Where instances overlap, the one later in that order wins.
+template<typename S, typename B>
+constexpr void blitSprites(const S& spritePicture, std::span<SpriteInstance> instances, B* buffer, int bufferPixelPitch, Vec2i clipLowerLeft, Vec2i clipUpperRight) {
+    std::sort(instances.begin(), instances.end(), [](const SpriteInstance& a, const SpriteInstance& b) {
+        if (a.frameNumber != b.frameNumber)
+            return a.frameNumber < b.frameNumber;
+        if (a.position.y != b.position.y)
+            return a.position.y < b.position.y;
+        return a.position.x < b.position.x;
+    });
+    for (const SpriteInstance& instance : instances) {
+        blitSprite(spritePicture, instance.frameNumber, buffer, bufferPixelPitch, instance.position, clipLowerLeft, clipUpperRight);
     }
 }
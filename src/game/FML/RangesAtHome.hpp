@@ -11,6 +11,7 @@
 #include <vector>
 #include <utility>
 #include <memory>
+#include <optional>
 #include <type_traits>
 #include <algorithm>
 
@@ -488,13 +489,14 @@ struct batch_view {
             size_t i = 0;
             if constexpr (Wrap) {
                 if constexpr (!std::is_copy_assignable_v<InputIterator>) {
-                    std::unique_ptr<InputIterator> inputCopy = std::make_unique<InputIterator>(mInputIt);
+                    // rebuilt in place instead of assigned, without going to the heap
+                    std::optional<InputIterator> inputCopy{mInputIt};
                     while (i < N) {
                         result[i] = *(*inputCopy);
                         ++*inputCopy;
                         ++i;
                         if (!(*inputCopy != mEnd)) {
-                            inputCopy.reset(new InputIterator{mBegin});
+                            inputCopy.emplace(mBegin);
                         }
                     }
                 } else {
@@ -28,7 +28,7 @@ struct FixedPointReal {
     }
 
     constexpr FixedPointReal(T value) requires(P == 0) {
-        return data = value;
+        data = value;
     }
 
     template <int Q>
@@ -11,11 +11,18 @@
 #include "Drawing/Palettes.hpp"
 #include "Drawing/Images.hpp"
 #include "Drawing/Generators.hpp"
+#include "Drawing/DirtyRows.hpp"
+#include "Drawing/PaletteExpansion.hpp"
 #include "Audio/Waves.hpp"
 #include "Math/Vec2Math.hpp"
 #include "FML/RangesAtHome.hpp"
 #include "Utility/Text.hpp"
 #include "Utility/Flags.hpp"
+#include "Utility/TripleBuffer.hpp"
+#include "Utility/WorkerPool.hpp"
+#include "Utility/Arena.hpp"
+#include "Profiling/Zones.hpp"
+#include "Profiling/MemoryReport.hpp"
 
 #include <array>
 #include <random>
@@ -82,6 +89,8 @@ struct Screen
     TextBuffer_t buffer;
     ColorBuffer_t color;
     Vec2i marker;
+    // text lines that changed since the last draw, isDirty redraws all of them
+    DirtyRows<LineCount> dirtyLines;
     bool isDirty;
     bool showMarker;
 };
@@ -93,6 +102,7 @@ void print(Screen_t& screen, const std::u32string_view& str, ranges_at_home::aRa
     {
         if (isValidImageIndex(screen.buffer, position)) {
             screen.buffer.at(position) = CharacterRom::PET::CharacterForCodepoint(character).value_or(static_cast<Screen_t::Text_t>(CharacterRom::PET::SpecialCharacters::Bullet));
+            screen.dirtyLines.mark(position.y);
             if (color.has_value()) {
                 screen.color.at(position) = color.value();
             }
@@ -105,6 +115,7 @@ void print(Screen_t& screen, const std::string_view& str, ranges_at_home::aRange
     {
         if (isValidImageIndex(screen.buffer, position)) {
             screen.buffer.at(position) = CharacterRom::PET::CharacterForCodepoint(character).value_or(static_cast<Screen_t::Text_t>(CharacterRom::PET::SpecialCharacters::Bullet));
+            screen.dirtyLines.mark(position.y);
             if (color.has_value()) {
                 screen.color.at(position) = color.value();
             }
@@ -113,15 +124,25 @@ void print(Screen_t& screen, const std::string_view& str, ranges_at_home::aRange
 }
 
 
-void draw(const Screen_t& screen, anImageOf<uint8_t> auto& destination)
+// redraws the given text lines and marks the rows they cover in dirtyRows
+template <size_t Height>
+void draw(const Screen_t& screen, anImageOf<uint8_t> auto& destination, const DirtyRows<Screen_t::LineCount>& lines, DirtyRows<Height>& dirtyRows)
 {
+    PROFILE_ZONE("draw Screen");
     using namespace ranges_at_home;
     auto line = destination.line(destination.height() - Screen_t::CharacterHeight);
     uint8_t* drawPointer = line.data();
     auto textLines = screen.buffer.linesView();
     auto colorLines = screen.color.linesView();
+    size_t lineIndex = 0;
     for (const auto [textLine, colorLine] : zip(textLines, colorLines))
     {
+        if (!lines.test(lineIndex++)) {
+            drawPointer -= destination.pitch() * Screen_t::CharacterHeight;
+            continue;
+        }
+        // text runs top to bottom, the destination bottom to top
+        dirtyRows.mark(destination.height() - lineIndex * Screen_t::CharacterHeight, Screen_t::CharacterHeight);
         uint8_t* linePointer = drawPointer;
         for (int y = Screen_t::CharacterHeight - 1; y >= 0; --y) {
             uint64_t* dst = reinterpret_cast<uint64_t*>(linePointer);
@@ -143,10 +164,20 @@ void draw(const Screen_t& screen, anImageOf<uint8_t> auto& destination)
 
 using VideoBuffer_t = Image<uint8_t, DrawBufferWidth, DrawBufferHeight>;
 
-struct GameMemory {
+struct VideoFrame {
     std::array<uint32_t, 256> palette;
     VideoBuffer_t videobuffer;
-    bool isVideoBufferDirty;
+    // rows each published frame changed, so writeDrawBuffer only expands those
+    DirtyRowsHistory<DrawBufferHeight> changedRows;
+};
+
+struct GameMemory {
+    // doGameThings draws into video.back(), writeDrawBuffer expands what was published
+    TripleBuffer<VideoFrame> video;
+    // rows of the back buffer with changes that were not published yet
+    DirtyRows<DrawBufferHeight> dirtyRows;
+    // owned by writeDrawBuffer, the changedRows serial of the frame it expanded last, 0 to expand the latest in full
+    uint64_t expandedSerial;
 
     GameState state, previousState;
     GameBoard_t board;
@@ -161,20 +192,31 @@ struct GameMemory {
     uint32_t activeControllerIndex;
     Vec2i moveSelector;
     AutoResettingTimer moveTimer;
+
+    // the rest of the memory block
+    Arena arena;
+    // out of arena, emptied before every tick
+    Arena frameArena;
 };
 
-void resetGame(GameMemory& memory) {
+// the seed comes from the input, so replaying a recorded session lays out the same board
+void resetGame(GameMemory& memory, uint32_t seed) {
+    PROFILE_FUNCTION();
     memory.selectedCell = {};
     memory.board.fill(CellState::Free);
 
     auto originIndex = Vec2i{0,0};
     auto cornerIndex = memory.board.maxIndex();
 
-    auto indices = (Generators::Rectangle(originIndex, cornerIndex) | ranges_at_home::toArray<WIDTH * HEIGHT>())();
+    auto indices = memory.frameArena.allocateSpan<Vec2i>(WIDTH * HEIGHT);
+    size_t indexCount = 0;
+    for (auto position : Generators::Rectangle(originIndex, cornerIndex)) {
+        indices[indexCount++] = position;
+    }
 
-    std::array<Vec2i, MINECOUNT> minePositions;
+    auto minePositions = memory.frameArena.allocateSpan<Vec2i>(MINECOUNT);
     std::sample(indices.begin(), indices.end(), minePositions.begin(),
-                MINECOUNT, std::mt19937{std::random_device{}()});
+                MINECOUNT, std::mt19937{seed});
 
     for (auto minePosition : minePositions) {
         memory.board.at(minePosition) = CellState::Mine;
@@ -196,12 +238,13 @@ void resetGame(GameMemory& memory) {
         memory.board.at(position) = static_cast<CellState>(mineCount);
     }
 
-    for (auto& cell : memory.board.pixels()) {
+    memory.board.forEachPixel([](CellState_t& cell) {
         cell.set(CellState::HiddenFlag);
-    }
+    });
 }
 
 void showBoard(const GameBoard_t& board, Screen_t& screen, Vec2i offset) {
+    PROFILE_FUNCTION();
     for (auto position : Generators::Rectangle(Vec2i{}, board.maxIndex()))
     {
         auto destination = position + offset;
@@ -257,6 +300,7 @@ void showBoard(const GameBoard_t& board, Screen_t& screen, Vec2i offset) {
         screen.color.at(destination) = c;
 
     }
+    screen.dirtyLines.mark(static_cast<size_t>(offset.y), static_cast<size_t>(board.height()));
 }
 
 template <typename T, typename U> requires aStaticImage<T> && aStaticImage<U>
@@ -275,6 +319,7 @@ Vec2i mapPositions(auto position, const T& imageFrom, const U& imageTo) {
 }
 
 void onActionUnhideSelect(GameMemory& memory) {
+    PROFILE_FUNCTION();
     const Vec2i boardPosition = memory.selectedCell;
     if (boardPosition >= Vec2i{} && boardPosition <= memory.board.maxIndex()) {
         auto& cell = memory.board.at(boardPosition);
@@ -314,7 +359,7 @@ void onActionUnhideSelect(GameMemory& memory) {
 
             }
 
-            auto cells = memory.board.pixels();
+            auto cells = memory.board.contiguousPixels();
             if (std::all_of(cells.begin(), cells.end(), [](auto& c) {
                 return !c.test(CellState::HiddenFlag) || c == CellState::HiddenMine || c == CellState::FlaggedMine;
             })) {
@@ -322,7 +367,6 @@ void onActionUnhideSelect(GameMemory& memory) {
             };
 
             showBoard(memory.board, memory.screen, memory.boardOffset);
-            memory.screen.isDirty = true;
         }
     }
 }
@@ -334,7 +378,6 @@ void onActionFlagSelected(GameMemory& memory) {
         if (cell.test(CellState::HiddenFlag)) {
             cell.toggle(CellState::FlaggedFlag);
             showBoard(memory.board, memory.screen, memory.boardOffset);
-            memory.screen.isDirty = true;
         }
     }
 }
@@ -347,8 +390,39 @@ struct Minesweeper {
     using AudioBuffer = Audio::PCM16StereoBuffer<AudioFramesPerBuffer>;
     using MemoryLayout = GameMemory;
 
+    // bump when the inside of a member's type changes, the hash of describeMemory() only sees its name and size
+    compiletime uint32_t MemoryLayoutVersion = 1;
+
+    static void describeMemory(const MemoryLayout& memory, MemoryReport::Report<>& report)
+    {
+        using namespace MemoryReport;
+        static_assert(coversLayout(&GameMemory::video, &GameMemory::dirtyRows, &GameMemory::expandedSerial, &GameMemory::state,
+                                   &GameMemory::previousState, &GameMemory::board, &GameMemory::turnCount, &GameMemory::selectedCell,
+                                   &GameMemory::boardOffset, &GameMemory::screen, &GameMemory::activeControllerIndex,
+                                   &GameMemory::moveSelector, &GameMemory::moveTimer, &GameMemory::arena, &GameMemory::frameArena),
+                      "every member of GameMemory needs a line below");
+        report.begin(memory, MemoryLayoutVersion);
+        report.add("video", memory, memory.video, TickThread | DrawThread);
+        report.add("dirtyRows", memory, memory.dirtyRows, TickThread);
+        report.add("expandedSerial", memory, memory.expandedSerial, DrawThread);
+        report.add("state", memory, memory.state, TickThread);
+        report.add("previousState", memory, memory.previousState, TickThread);
+        report.add("board", memory, memory.board, TickThread);
+        report.add("turnCount", memory, memory.turnCount, TickThread);
+        report.add("selectedCell", memory, memory.selectedCell, TickThread);
+        report.add("boardOffset", memory, memory.boardOffset, TickThread);
+        report.add("screen", memory, memory.screen, TickThread);
+        report.add("activeControllerIndex", memory, memory.activeControllerIndex, TickThread);
+        report.add("moveSelector", memory, memory.moveSelector, TickThread);
+        report.add("moveTimer", memory, memory.moveTimer, TickThread);
+        report.add("arena", memory, memory.arena, TickThread);
+        report.add("frameArena", memory, memory.frameArena, TickThread);
+        report.end();
+    }
+
     static GameOutput doGameThings(MemoryLayout& memory, const FrameInput::Input& input, const PlatformCallbacks& callbacks)
     {
+        PROFILE_ZONE("Minesweeper::doGameThings");
         using namespace ranges_at_home;
         using namespace Generators;
         using namespace std::chrono_literals;
@@ -383,7 +457,8 @@ struct Minesweeper {
         memory.previousState = memory.state;
         switch(memory.state) {
             case GameState::Init:
-                PaletteC64::writeTo(memory.palette.data());
+                memory.video.reset();
+                PaletteC64::writeTo(memory.video.back().palette.data());
                 callbacks.readFile(CharROM::Filename.data(), memory.screen.characters.front().bytes(), sizeof(memory.screen.characters));
                 memory.screen.buffer.fill(CharROM::CharacterTable[' ']);
                 memory.screen.color.fill(color);
@@ -406,7 +481,7 @@ struct Minesweeper {
                 if (primary) {
                     // check if user selected start game
                     memory.state = GameState::Play;
-                    resetGame(memory);
+                    resetGame(memory, static_cast<uint32_t>(input.upTime_microseconds));
                     memory.screen.buffer.fill(CharROM::CharacterTable[' ']);
                     memory.turnCount = 0;
                     memory.selectedCell = Vec2i();
@@ -422,7 +497,7 @@ struct Minesweeper {
                 auto mouseOverBoardPos = Vec2i{};
                 if (input.mouse.endedOver && input.mouse.track.size() > 1) {
                     auto mousePos = input.mouse.track.back();
-                    auto screenBufferPos = mapPositions(mousePos, memory.videobuffer, memory.screen.buffer);
+                    auto screenBufferPos = mapPositions(mousePos, memory.video.back().videobuffer, memory.screen.buffer);
                     mouseOverBoardPos = screenBufferPos - memory.boardOffset;
                     if (mouseOverBoardPos >= Vec2i{} && mouseOverBoardPos <= memory.board.maxIndex()) {
                         output.shouldShowSystemCursor = false;
@@ -434,7 +509,7 @@ struct Minesweeper {
                 }
                 else if (!input.taps.empty()) {
                     auto tapPos = input.taps.back().position;
-                    auto screenBufferPos = mapPositions(tapPos, memory.videobuffer, memory.screen.buffer);
+                    auto screenBufferPos = mapPositions(tapPos, memory.video.back().videobuffer, memory.screen.buffer);
                     mouseOverBoardPos = screenBufferPos - memory.boardOffset;
                     memory.selectedCell = mouseOverBoardPos + Vec2i{0,1};
                 }
@@ -455,9 +530,13 @@ struct Minesweeper {
                 }
                 
                 memory.selectedCell = clamp(memory.selectedCell, Vec2i{}, memory.board.maxIndex());
-                memory.screen.marker = memory.selectedCell + memory.boardOffset;
+                if (const Vec2i marker = memory.selectedCell + memory.boardOffset; marker != memory.screen.marker) {
+                    // redrawing both text lines wipes the old marker, the new one is drawn over them below
+                    memory.screen.dirtyLines.mark(static_cast<size_t>(memory.screen.marker.y));
+                    memory.screen.dirtyLines.mark(static_cast<size_t>(marker.y));
+                    memory.screen.marker = marker;
+                }
                 memory.screen.showMarker = true;
-                memory.screen.isDirty = true;
 
                 // back button
                 if (buttonPressed(controller.buttonBack)) {
@@ -484,20 +563,19 @@ struct Minesweeper {
             case GameState::Pause: break;
             case GameState::Lose:
                 if (stateWasEntered) {
-                    for (auto& cell : memory.board.pixels()) {
+                    memory.board.forEachPixel([](CellState_t& cell) {
                         if (cell == CellState::HiddenMine) {
                             cell = CellState::Mine;
                         }
-                    }
+                    });
 
 
-                    std::array<char, 128> buffer;
-                    size_t count = snprintf(buffer.data(), 128, "You lost after %d turns", memory.turnCount);
+                    auto buffer = memory.frameArena.allocateSpan<char>(128);
+                    size_t count = snprintf(buffer.data(), buffer.size(), "You lost after %d turns", memory.turnCount);
                     std::string_view sv{buffer.data(), count};
 
                     print(memory.screen, sv, Generators::Rectangle({0,1}, {10,3}));
                     showBoard(memory.board, memory.screen, memory.boardOffset);
-                    memory.screen.isDirty = true;
                 }
                 if (primary) {
                     memory.state = GameState::Menu;
@@ -510,14 +588,18 @@ struct Minesweeper {
                 break;
         }
 
+        VideoBuffer_t& videobuffer = memory.video.back().videobuffer;
         if (memory.screen.isDirty) {
-            draw(memory.screen, memory.videobuffer);
+            memory.screen.dirtyLines.markAll();
             memory.screen.isDirty = false;
-            memory.isVideoBufferDirty = true;
+        }
+        if (memory.screen.dirtyLines.any()) {
+            draw(memory.screen, videobuffer, memory.screen.dirtyLines, memory.dirtyRows);
+            memory.screen.dirtyLines.clear();
         }
 
         if (memory.screen.showMarker) {
-            auto markerPosition = mapPositions(memory.screen.marker, memory.screen.buffer, memory.videobuffer);
+            auto markerPosition = mapPositions(memory.screen.marker, memory.screen.buffer, videobuffer);
             for (auto pix :
                  concat(
                      concat(
@@ -526,19 +608,31 @@ struct Minesweeper {
                              VLine(markerPosition, -CHARACTER_HEIGHT),
                              VLine(markerPosition + Vec2i{CHARACTER_WIDTH - 1, 0}, -CHARACTER_HEIGHT))),
                     HLine(markerPosition + Vec2i{0, 1 - CHARACTER_HEIGHT}, CHARACTER_WIDTH))) {
-                if (pix >= Vec2i{} && pix < memory.videobuffer.size2d()) {
-                    memory.videobuffer.at(pix) = 1;
+                if (pix >= Vec2i{} && pix < videobuffer.size2d()) {
+                    // the marker stays inside its text line, which is dirty whenever the marker has to be redrawn
+                    videobuffer.at(pix) = 1;
                 }
             }
-            memory.isVideoBufferDirty = true;
+        }
+
+        if (memory.dirtyRows.any()) {
+            // the screen is only redrawn where it changed, so the next frame starts from this one
+            memory.video.back().changedRows.push(memory.dirtyRows);
+            memory.video.publishAndCarryOver();
+            memory.dirtyRows.clear();
         }
 
         return output;
     }
 
-    static void writeDrawBuffer(MemoryLayout& memory, DrawBuffer& buffer)
+    static void writeDrawBuffer(MemoryLayout& memory, DrawBuffer& buffer, DirtyRows<DrawBufferHeight>& changed, WorkerPool& workers,
+                                PaletteExpansion::Expander& expander)
     {
-        if (memory.state == GameState::Init) {
+        PROFILE_ZONE("Minesweeper::writeDrawBuffer");
+        if (!memory.video.hasPublished()) {
+            // nothing to expand yet, and the first frame has to replace all of this
+            memory.expandedSerial = 0;
+            changed.markAll();
             int colorIndex = 0;
             WebColorRGB colors[] { WebColorRGB::Aqua, WebColorRGB::WhiteSmoke, WebColorRGB::HotPink, WebColorRGB::Black };
             for (auto line : buffer.linesView())
@@ -548,47 +642,37 @@ struct Minesweeper {
                     pix = 0xFF000000 | static_cast<ColorARGB>(lineColor);
                 }
             }
-        } else  if(memory.isVideoBufferDirty) {
-            constant auto stride = sizeof(uint64_t);
+        } else if (const VideoFrame* frame = memory.expandedSerial ? memory.video.fresh() : memory.video.latest()) {
             constant auto width = DrawBuffer{}.width();
-            static_assert (width % stride == 0);
-            constant auto height = DrawBuffer{}.height();
-
-            const uint32_t* palette = memory.palette.data();
-            uint64_t* src = reinterpret_cast<uint64_t*>(memory.videobuffer.data());
-            uint64_t* dst = reinterpret_cast<uint64_t*>(buffer.data());
-
-            constant auto dstpitch = DrawBuffer{}.pitch() / 2; // 64 bit batch = 2 x 32 bit values
-            constant auto srcpitch = VideoBuffer_t{}.pitch() / 8; // 64 bit batch = 8 x 8 bit values
-
-            for (uint32_t y = 0; y < height; ++y) {
-                auto srcLine = src;
-                auto dstLine = dst;
-                for (uint32_t x = 0; x < width; x += stride) {
-                    const uint64_t sourcePixel8 = *srcLine++;
-
-                    dstLine[0] = static_cast<uint64_t>(palette[sourcePixel8 >> 0 & 0xff]) |
-                        static_cast<uint64_t>(palette[sourcePixel8 >> 8 & 0xff]) << 32;
-                    dstLine[1] = static_cast<uint64_t>(palette[sourcePixel8 >> 16 & 0xff]) |
-                        static_cast<uint64_t>(palette[sourcePixel8 >> 24 & 0xff]) << 32;
-                    dstLine[2] = static_cast<uint64_t>(palette[sourcePixel8 >> 32 & 0xff]) |
-                        static_cast<uint64_t>(palette[sourcePixel8 >> 40 & 0xff]) << 32;
-                    dstLine[3] = static_cast<uint64_t>(palette[sourcePixel8 >> 48 & 0xff]) |
-                        static_cast<uint64_t>(palette[sourcePixel8 >> 56 & 0xff]) << 32;
-                    dstLine += 4;
-                }
-                src += srcpitch;
-                dst += dstpitch;
+            static_assert (width == VideoBuffer_t{}.pitch() && width == DrawBuffer{}.pitch(), "spans of rows have to be contiguous");
+            static_assert (DrawBuffer{}.height() == VideoBuffer_t{}.height());
+
+            const uint8_t* src = frame->videobuffer.data();
+            uint32_t* dst = buffer.data();
+
+            // everything since the frame expanded last, the ones in between may have been skipped
+            changed = frame->changedRows.since(memory.expandedSerial);
+            memory.expandedSerial = frame->changedRows.serial;
+            if (expander.prepare(frame->palette.data(), PaletteC64::count)) {
+                changed.markAll();
             }
-            memory.isVideoBufferDirty = false;
+
+            changed.forEachSpan([&](size_t first, size_t count) {
+                expander.expandRows(workers, src, dst, width, first, count);
+            });
         }
     }
 
-    static void writeAudioBuffer(MemoryLayout& memory, AudioBuffer& buffer, const AudioBufferDescriptor& /*bufferDescriptor*/)
+    // the frame the draw buffer shows is forgotten, the next writeDrawBuffer expands the latest one in full
+    static void invalidateDrawBuffer(MemoryLayout& memory)
+    {
+        memory.expandedSerial = 0;
+    }
+
+    static void writeAudioBuffer(MemoryLayout& /*memory*/, AudioBuffer& buffer, const AudioBufferDescriptor& /*bufferDescriptor*/)
     {
         buffer.clear();
        // printf("%lf\n", bufferDescriptor.sampleTime / bufferDescriptor.sampleRate);
-        memory = memory;
     }
 
 };
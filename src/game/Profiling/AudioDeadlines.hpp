@@ -0,0 +1,187 @@
+//
+//  AudioDeadlines.hpp
+//  Project256
+//
+//  Checks every writeAudioBuffer call against the time its buffer starts
+//  playing. The platform keeps AudioBufferCount buffers queued, so a buffer is
+//  requested when the one before the queue's last finishes, and has to be done
+//  by the time everything queued ahead of it has played:
+//
+//    requested   = deadline - (AudioBufferCount - 1) * buffer duration
+//    deadline    = stream start + sampleTime / sampleRate
+//    margin      = deadline - call end
+//
+//  A negative margin is an underrun, one of less than nearMiss_ns a near miss.
+//  For the buffers that came close, the largest of waking up late, waiting for
+//  a lock and computing the samples is counted as the cause.
+//
+//  Record from the audio thread only, read once it is done or stopped. The
+//  profiling_audio_* functions in Timings.h keep one for the platform's real
+//  audio callback and can be printed from any other thread while it runs.
+//
+
+#pragma once
+
+#include "../defines.h"
+#include "../Project256.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+
+namespace AudioDeadlines {
+
+enum class Cause : uint8_t {
+    // the call started well after the buffer was requested
+    Scheduling,
+    // waited for the game's state
+    Lock,
+    // writing the samples took most of the time
+    Compute,
+    Count
+};
+
+compiletime size_t CauseCount = static_cast<size_t>(Cause::Count);
+
+constexpr const char* causeName(Cause cause) {
+    switch (cause) {
+        case Cause::Scheduling: return "scheduling";
+        case Cause::Lock: return "lock";
+        case Cause::Compute: return "compute";
+        default: return "?";
+    }
+}
+
+inline int64_t now_ns() {
+    return static_cast<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Time the last writeAudioBuffer call spent waiting for locks it shares with doGameThings.
+// The game stores it, the platform reads it right after the call returns.
+inline std::atomic<int64_t> lastLockWait_ns{};
+
+// locks mutex, and if it was taken, stores the time spent waiting for it in lastLockWait_ns
+template <typename Mutex>
+std::unique_lock<Mutex> lockMeasuringWait(Mutex& mutex) {
+    std::unique_lock<Mutex> lock(mutex, std::try_to_lock);
+    int64_t waited = 0;
+    if (!lock.owns_lock()) {
+        const int64_t start = now_ns();
+        lock.lock();
+        waited = now_ns() - start;
+    }
+    lastLockWait_ns.store(waited, std::memory_order_relaxed);
+    return lock;
+}
+
+struct Monitor {
+    double sampleRate;
+    unsigned framesPerBuffer;
+    unsigned queueLength;
+    // platform time in nanoseconds at which sample 0 of the stream plays
+    int64_t streamStart_ns;
+    // margins below this are near misses, one buffer duration unless set after start()
+    int64_t nearMiss_ns;
+
+    uint64_t bufferCount;
+    uint64_t nearMissCount;
+    uint64_t underrunCount;
+    // near misses and underruns by what took the most time
+    std::array<uint64_t, CauseCount> causeCount;
+    int64_t worstMargin_ns;
+    double worstSampleTime;
+    int64_t marginSum_ns;
+    int64_t maxWakeLatency_ns;
+    int64_t maxLockWait_ns;
+    int64_t maxCompute_ns;
+
+    void start(int64_t streamStart, double rate, unsigned frames = AudioFramesPerBuffer, unsigned queued = AudioBufferCount) {
+        *this = {};
+        sampleRate = rate;
+        framesPerBuffer = frames;
+        queueLength = queued;
+        streamStart_ns = streamStart;
+        nearMiss_ns = bufferDuration_ns();
+        worstMargin_ns = INT64_MAX;
+    }
+
+    int64_t bufferDuration_ns() const {
+        return static_cast<int64_t>(framesPerBuffer * 1e9 / sampleRate);
+    }
+
+    int64_t deadline_ns(double sampleTime) const {
+        return streamStart_ns + static_cast<int64_t>(sampleTime * 1e9 / sampleRate);
+    }
+
+    int64_t requested_ns(double sampleTime) const {
+        return deadline_ns(sampleTime) - static_cast<int64_t>(queueLength > 0 ? queueLength - 1 : 0) * bufferDuration_ns();
+    }
+
+    // one writeAudioBuffer call for the buffer starting at sampleTime, returns its margin
+    int64_t record(double sampleTime, int64_t callStart_ns, int64_t callEnd_ns, int64_t lockWait_ns = 0) {
+        const int64_t margin = deadline_ns(sampleTime) - callEnd_ns;
+        const int64_t wakeLatency = callStart_ns - requested_ns(sampleTime);
+        const int64_t compute = callEnd_ns - callStart_ns - lockWait_ns;
+
+        ++bufferCount;
+        marginSum_ns += margin;
+        if (margin < worstMargin_ns) {
+            worstMargin_ns = margin;
+            worstSampleTime = sampleTime;
+        }
+        maxWakeLatency_ns = wakeLatency > maxWakeLatency_ns ? wakeLatency : maxWakeLatency_ns;
+        maxLockWait_ns = lockWait_ns > maxLockWait_ns ? lockWait_ns : maxLockWait_ns;
+        maxCompute_ns = compute > maxCompute_ns ? compute : maxCompute_ns;
+
+        if (margin < nearMiss_ns) {
+            if (margin < 0) {
+                ++underrunCount;
+            } else {
+                ++nearMissCount;
+            }
+            Cause cause = Cause::Scheduling;
+            int64_t largest = wakeLatency;
+            if (lockWait_ns > largest) {
+                cause = Cause::Lock;
+                largest = lockWait_ns;
+            }
+            if (compute > largest) {
+                cause = Cause::Compute;
+            }
+            ++causeCount[static_cast<size_t>(cause)];
+        }
+        return margin;
+    }
+
+    // a summary on two lines under title, returns the number of characters written like snprintf but never more than fit
+    int print(char* buffer, int bufferSize, const char* title = "audio deadlines") const {
+        if (bufferSize <= 0)
+            return 0;
+        const double toMs = 1e-6;
+        const int written = std::snprintf(buffer, static_cast<size_t>(bufferSize),
+            "%s: %llu buffers, %llu underruns, %llu near misses (< %.2f ms), margin mean %.2f ms worst %.2f ms at sample %.0f\n"
+            "  late because of scheduling %llu, lock %llu, compute %llu; max wake latency %.3f ms, lock wait %.3f ms, compute %.3f ms\n",
+            title,
+            static_cast<unsigned long long>(bufferCount),
+            static_cast<unsigned long long>(underrunCount),
+            static_cast<unsigned long long>(nearMissCount),
+            nearMiss_ns * toMs,
+            bufferCount ? double(marginSum_ns) / bufferCount * toMs : 0.0,
+            bufferCount ? worstMargin_ns * toMs : 0.0,
+            worstSampleTime,
+            static_cast<unsigned long long>(causeCount[static_cast<size_t>(Cause::Scheduling)]),
+            static_cast<unsigned long long>(causeCount[static_cast<size_t>(Cause::Lock)]),
+            static_cast<unsigned long long>(causeCount[static_cast<size_t>(Cause::Compute)]),
+            maxWakeLatency_ns * toMs,
+            maxLockWait_ns * toMs,
+            maxCompute_ns * toMs);
+        if (written < 0)
+            return 0;
+        return written < bufferSize ? written : bufferSize - 1;
+    }
+};
+
+}
@@ -0,0 +1,227 @@
+//
+//  MemoryReport.hpp
+//  Project256
+//
+//  A report of where the members of a game's memory layout sit in the MemorySize
+//  block: offset, size, alignment, the padding in front of them, the cache lines
+//  they cover and the threads that touch them. Members that share a cache line
+//  with a member used by other threads are flagged, that line bounces between
+//  the cores whenever both sides write.
+//
+//  Each game lists its members once in describeMemory(), the offsets come from
+//  the actual memory so nothing in the layout has to be standard layout.
+//
+//  The hash of a report decides whether a hot reloaded module may take over the
+//  memory. It sees the members' placement and the names of their types, not what
+//  is inside those types: every game has a MemoryLayoutVersion to bump when a
+//  member's type changes inside without changing its name, and checks with
+//  coversLayout() that describeMemory() leaves no member out.
+//
+
+#pragma once
+
+#include "../defines.h"
+#include "../Project256.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace MemoryReport {
+
+compiletime size_t CacheLineSize = 64;
+
+// the threads a member is used from
+enum Threads : uint8_t {
+    // doGameThings
+    TickThread = 1,
+    // writeDrawBuffer
+    DrawThread = 2,
+    // writeAudioBuffer
+    AudioThread = 4,
+};
+
+// the name of T, the same in every build of the same source with the same compiler
+template <typename T>
+constexpr const char* typeSignature() {
+#if defined(_MSC_VER)
+    return __FUNCSIG__;
+#else
+    return __PRETTY_FUNCTION__;
+#endif
+}
+
+// True when the members pointed to, one of each of a layout's members, take up all of
+// it but the padding their alignment may need. A member left out is only missed when
+// it fits into that padding.
+template <typename Layout, typename... Ts>
+constexpr bool coversLayout(Ts Layout::*...) {
+    constexpr size_t described = (sizeof(Ts) + ... + 0);
+    constexpr size_t mostPadding = ((alignof(Ts) - 1) + ... + 0) + alignof(Layout) - 1;
+    return described <= sizeof(Layout) && sizeof(Layout) <= described + mostPadding;
+}
+
+struct Member {
+    const char* name;
+    const char* type;
+    size_t offset;
+    size_t size;
+    size_t alignment;
+    uint8_t threads;
+};
+
+template <size_t MaxMembers = 64>
+struct Report {
+    std::array<Member, MaxMembers> members;
+    size_t memberCount;
+    size_t layoutSize;
+    size_t layoutAlignment;
+    uint32_t layoutVersion;
+
+    // version is the game's MemoryLayoutVersion
+    template <typename Layout>
+    void begin(const Layout&, uint32_t version) {
+        memberCount = 0;
+        layoutSize = sizeof(Layout);
+        layoutAlignment = alignof(Layout);
+        layoutVersion = version;
+    }
+
+    template <typename Layout, typename T>
+    void add(const char* name, const Layout& layout, const T& member, uint8_t threads) {
+        if (memberCount == MaxMembers)
+            return;
+        const auto offset = reinterpret_cast<const std::byte*>(&member) - reinterpret_cast<const std::byte*>(&layout);
+        members[memberCount++] = { name, typeSignature<T>(), static_cast<size_t>(offset), sizeof(T), alignof(T), threads };
+    }
+
+    // sorted by offset once the members are in
+    void end() {
+        std::sort(members.begin(), members.begin() + memberCount,
+                  [](const Member& a, const Member& b) { return a.offset < b.offset; });
+    }
+
+    // FNV-1a over the layout's size and version and every member's name, type, offset, size and
+    // alignment. Code built against a different layout hashes differently, unless all that changed
+    // is inside a member's type and the version stayed the same.
+    uint64_t hash() const {
+        uint64_t result = 14695981039346656037ull;
+        auto mix = [&](const void* data, size_t size) {
+            for (size_t i = 0; i < size; ++i) {
+                result = (result ^ static_cast<const uint8_t*>(data)[i]) * 1099511628211ull;
+            }
+        };
+        const uint64_t layout[] = { layoutSize, layoutAlignment, layoutVersion };
+        mix(layout, sizeof(layout));
+        for (size_t i = 0; i < memberCount; ++i) {
+            const Member& member = members[i];
+            mix(member.name, std::strlen(member.name) + 1);
+            mix(member.type, std::strlen(member.type) + 1);
+            const uint64_t placement[] = { member.offset, member.size, member.alignment };
+            mix(placement, sizeof(placement));
+        }
+        return result;
+    }
+
+    size_t paddingBefore(size_t index) const {
+        const size_t previousEnd = index == 0 ? 0 : members[index - 1].offset + members[index - 1].size;
+        return members[index].offset > previousEnd ? members[index].offset - previousEnd : 0;
+    }
+
+    size_t trailingPadding() const {
+        const size_t end = memberCount == 0 ? 0 : members[memberCount - 1].offset + members[memberCount - 1].size;
+        return layoutSize > end ? layoutSize - end : 0;
+    }
+
+    // Bytes between the members that their alignment does not explain, where a member without a
+    // line in describeMemory() sits. A member may be aligned further than its type, so each one is
+    // taken to need the largest power of two its offset is a multiple of, up to the layout's.
+    size_t undescribedBytes() const {
+        size_t undescribed = 0;
+        size_t previousEnd = 0;
+        for (size_t i = 0; i <= memberCount; ++i) {
+            const size_t offset = i < memberCount ? members[i].offset : layoutSize;
+            size_t alignment = offset ? offset & (~offset + 1) : layoutAlignment;
+            alignment = alignment < layoutAlignment ? alignment : layoutAlignment;
+            const size_t alignedEnd = (previousEnd + alignment - 1) / alignment * alignment;
+            undescribed += offset > alignedEnd ? offset - alignedEnd : 0;
+            if (i < memberCount) {
+                previousEnd = std::max(previousEnd, offset + members[i].size);
+            }
+        }
+        return undescribed;
+    }
+
+    size_t totalPadding() const {
+        size_t padding = trailingPadding();
+        for (size_t i = 0; i < memberCount; ++i) {
+            padding += paddingBefore(i);
+        }
+        return padding;
+    }
+
+    static size_t firstLine(const Member& member) {
+        return member.offset / CacheLineSize;
+    }
+
+    static size_t lastLine(const Member& member) {
+        return (member.offset + (member.size ? member.size : 1) - 1) / CacheLineSize;
+    }
+
+    // the neighbour that shares a cache line with the member and is used from other threads, if any
+    const Member* sharesLineWith(size_t index) const {
+        const Member& member = members[index];
+        for (size_t other = index; other-- > 0;) {
+            if (lastLine(members[other]) < firstLine(member))
+                break;
+            if (members[other].threads != member.threads)
+                return &members[other];
+        }
+        for (size_t other = index + 1; other < memberCount; ++other) {
+            if (firstLine(members[other]) > lastLine(member))
+                break;
+            if (members[other].threads != member.threads)
+                return &members[other];
+        }
+        return nullptr;
+    }
+
+    // one line per member and a summary against MemorySize, returns the characters written
+    int print(char* buffer, int bufferSize) const {
+        int writtenTotal = 0;
+        auto printText = [&](const char* format, auto... args) {
+            if (bufferSize <= 0)
+                return;
+            const int written = std::snprintf(buffer, static_cast<size_t>(bufferSize), format, args...);
+            if (written < 0 || written >= bufferSize) {
+                writtenTotal += bufferSize - 1;
+                bufferSize = 0;
+                return;
+            }
+            buffer += written;
+            bufferSize -= written;
+            writtenTotal += written;
+        };
+
+        printText("%10s %10s %5s %5s %15s %-7s %s\n", "offset", "size", "align", "pad", "cache lines", "threads", "member");
+        for (size_t i = 0; i < memberCount; ++i) {
+            const Member& member = members[i];
+            char lines[48]; // two 20 digit numbers, the dash and the terminator
+            std::snprintf(lines, sizeof(lines), "%zu-%zu", firstLine(member), lastLine(member));
+            printText("%10zu %10zu %5zu %5zu %15s %c%c%c     %s", member.offset, member.size, member.alignment, paddingBefore(i), lines,
+                      member.threads & TickThread ? 'T' : '-', member.threads & DrawThread ? 'D' : '-', member.threads & AudioThread ? 'A' : '-',
+                      member.name);
+            if (const Member* neighbour = sharesLineWith(i)) {
+                printText("  shares a line with %s", neighbour->name);
+            }
+            printText("\n");
+        }
+        printText("%zu bytes (alignment %zu) with %zu bytes of padding, %.1f%% of the %ld byte MemorySize\n",
+                  layoutSize, layoutAlignment, totalPadding(), 100.0 * double(layoutSize) / double(MemorySize), MemorySize);
+        return writtenTotal;
+    }
+};
+
+}
@@ -9,10 +9,15 @@
 #ifdef PROFILING
 
 #include "Timings.h"
+#include "AudioDeadlines.hpp"
+#include "../Utility/TripleBuffer.hpp"
 #include <cstdio>
 #include <array>
 #include <string>
-#include <shared_mutex>
+#include <atomic>
+#include <bit>
+#include <climits>
+#include <cstring>
 
 #endif
 
@@ -32,35 +37,163 @@ static const std::array<std::array<char, 32>, TimingIntervalCount> sIntervalName
     "DrawBefore",
     "DrawWaitSetup",
     "DrawEncoding",
-    "DrawPresent"
+    "DrawPresent",
+    "RewindSnapshot"
 };
 
-globalvar std::shared_mutex Mutex{};
+// The tick, the render thread and the realtime audio callback all report here, so
+// nothing may block: every field of TimingData is its own atomic, accessed in place
+// through atomic_ref to keep the struct plain C. A sum and its count are updated
+// separately, a print or clear racing with an update can be off by one sample.
+static_assert(std::atomic_ref<int64_t>::is_always_lock_free && std::atomic_ref<int>::is_always_lock_free);
+static_assert(std::atomic_ref<int64_t>::required_alignment <= alignof(int64_t));
+
+compiletime int SubBucketCount = 1 << TimingHistogramSubBucketBits;
+
+// exact below SubBucketCount, then SubBucketCount buckets per power of two
+internalfunc int histogramBucket(int64_t microseconds)
+{
+    if (microseconds < SubBucketCount)
+        return microseconds < 0 ? 0 : static_cast<int>(microseconds);
+    const int exponent = std::bit_width(static_cast<uint64_t>(microseconds)) - 1;
+    const int subBucket = static_cast<int>(microseconds >> (exponent - TimingHistogramSubBucketBits)) & (SubBucketCount - 1);
+    const int bucket = (exponent - TimingHistogramSubBucketBits + 1) * SubBucketCount + subBucket;
+    return bucket < TimingHistogramBucketCount ? bucket : TimingHistogramBucketCount - 1;
+}
+
+// the largest value that falls into the bucket
+internalfunc int64_t histogramBucketUpperEdge(int bucket)
+{
+    if (bucket < SubBucketCount)
+        return bucket;
+    const int shift = bucket / SubBucketCount - 1;
+    const int64_t subBucket = bucket % SubBucketCount;
+    return ((SubBucketCount + subBucket + 1) << shift) - 1;
+}
+
+// The trace ring: writers claim a slot with one fetch_add and stamp it with its
+// sequence number once the fields are in, the reader copies a slot and only keeps
+// it if the stamp was the same before and after, like a seqlock.
+struct TraceEvent {
+    std::atomic<uint64_t> sequence;
+    std::atomic<int64_t> start;
+    std::atomic<int64_t> end;
+    std::atomic<uint32_t> threadId;
+    std::atomic<uint32_t> interval;
+};
+
+compiletime int TraceThreadNameCount = 32;
+compiletime int TraceThreadNameLength = 32;
+
+globalvar std::atomic<bool> sTraceEnabled{true};
+globalvar std::atomic<uint64_t> sTraceHead{};
+globalvar std::array<TraceEvent, TimingTraceCapacity> sTraceEvents{};
+globalvar std::atomic<uint32_t> sTraceThreadCount{};
+globalvar std::array<std::array<std::atomic<char>, TraceThreadNameLength>, TraceThreadNameCount> sTraceThreadNames{};
+
+// small numbers read better in the trace viewer than the OS thread ids
+internalfunc uint32_t traceThreadId()
+{
+    thread_local const uint32_t id = sTraceThreadCount.fetch_add(1, std::memory_order_relaxed) + 1;
+    return id;
+}
+
+internalfunc void traceRecord(TimingInterval interval, int64_t start, int64_t end)
+{
+    if (!sTraceEnabled.load(std::memory_order_relaxed))
+        return;
+    const uint64_t sequence = sTraceHead.fetch_add(1, std::memory_order_relaxed);
+    TraceEvent& event = sTraceEvents[sequence % TimingTraceCapacity];
+    // mark the slot as being written before touching the fields
+    event.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    event.threadId.store(traceThreadId(), std::memory_order_relaxed);
+    event.interval.store(interval, std::memory_order_relaxed);
+    event.sequence.store(sequence + 1, std::memory_order_release);
+}
+
+internalfunc void atomicMax(int64_t& target, int64_t value)
+{
+    auto atomic = std::atomic_ref(target);
+    int64_t current = atomic.load(std::memory_order_relaxed);
+    while (value > current && !atomic.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
 
 void profiling_time_set(TimingData* data, TimingTimer timer)
 {
-    std::unique_lock lock{Mutex};
-    data->timers[timer] = data->getPlatformTimeMicroseconds();
+    const auto now = data->getPlatformTimeMicroseconds();
+    std::atomic_ref(data->timers[timer]).store(now, std::memory_order_relaxed);
 }
 
 void profiling_time_interval(TimingData* data, TimingTimer timer, TimingInterval interval)
 {
-    std::unique_lock lock{Mutex};
-    auto now = data->getPlatformTimeMicroseconds();
-    auto elapsed = now - data->timers[timer];
-    data->intervals[interval] += elapsed;
-    data->timers[timer] = now;
-    data->intervalCount[interval]++;
+    const auto now = data->getPlatformTimeMicroseconds();
+    const auto start = std::atomic_ref(data->timers[timer]).exchange(now, std::memory_order_relaxed);
+    // a timer set on another thread, or a clock that stepped back, must not come out negative,
+    // INT64_MAX - elapsed below would overflow
+    const int64_t elapsed = now > start ? now - start : 0;
+    std::atomic_ref(data->intervals[interval]).fetch_add(elapsed, std::memory_order_relaxed);
+    std::atomic_ref(data->intervalCount[interval]).fetch_add(1, std::memory_order_relaxed);
+    // one more add and two compares, usually without a store, cheap enough to always keep
+    std::atomic_ref(data->histograms[interval][histogramBucket(elapsed)]).fetch_add(1, std::memory_order_relaxed);
+    atomicMax(data->intervalMax[interval], elapsed);
+    atomicMax(data->intervalMinFromTop[interval], INT64_MAX - elapsed);
+    traceRecord(interval, start, now);
+}
+
+int64_t profiling_time_percentile(TimingData* data, TimingInterval interval, double percentile)
+{
+    std::array<unsigned, TimingHistogramBucketCount> histogram;
+    uint64_t total = 0;
+    for (int bucket = 0; bucket < TimingHistogramBucketCount; ++bucket) {
+        histogram[bucket] = std::atomic_ref(data->histograms[interval][bucket]).load(std::memory_order_relaxed);
+        total += histogram[bucket];
+    }
+    if (total == 0)
+        return 0;
+
+    const int64_t minimum = INT64_MAX - std::atomic_ref(data->intervalMinFromTop[interval]).load(std::memory_order_relaxed);
+    const int64_t maximum = std::atomic_ref(data->intervalMax[interval]).load(std::memory_order_relaxed);
+    // the rank of the sample we are looking for, counting from 1
+    uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * total + 0.999999);
+    rank = rank < 1 ? 1 : (rank > total ? total : rank);
+
+    uint64_t seen = 0;
+    int bucket = 0;
+    for (; bucket < TimingHistogramBucketCount - 1; ++bucket) {
+        seen += histogram[bucket];
+        if (seen >= rank)
+            break;
+    }
+    const int64_t edge = histogramBucketUpperEdge(bucket);
+    return edge < minimum ? minimum : (edge > maximum ? maximum : edge);
 }
 
 int profiling_time_print(TimingData* data, char* buffer, int bufferSize)
 {
-    std::shared_lock lock{Mutex};
     int writtenTotal = 0;
     for (int interval = 0; interval < TimingIntervalCount; ++interval)
     {
-        int count = data->intervalCount[interval];
-        int written = std::snprintf(buffer, bufferSize, "%-16s %-5d %lld\n", sIntervalNames[interval].data(), count, (count != 0? data->intervals[interval] / count : 0LL));
+        const auto timingInterval = static_cast<TimingInterval>(interval);
+        const int count = std::atomic_ref(data->intervalCount[interval]).load(std::memory_order_relaxed);
+        const int64_t sum = std::atomic_ref(data->intervals[interval]).load(std::memory_order_relaxed);
+        const int64_t minimum = count ? INT64_MAX - std::atomic_ref(data->intervalMinFromTop[interval]).load(std::memory_order_relaxed) : 0;
+        const int64_t maximum = std::atomic_ref(data->intervalMax[interval]).load(std::memory_order_relaxed);
+        int written = std::snprintf(buffer, bufferSize, "%-18s %6d %7lld %7lld %7lld %7lld %7lld %7lld %7lld\n",
+            sIntervalNames[interval].data(), count,
+            (count != 0? static_cast<long long>(sum / count) : 0LL),
+            static_cast<long long>(minimum),
+            static_cast<long long>(profiling_time_percentile(data, timingInterval, 50)),
+            static_cast<long long>(profiling_time_percentile(data, timingInterval, 90)),
+            static_cast<long long>(profiling_time_percentile(data, timingInterval, 99)),
+            static_cast<long long>(profiling_time_percentile(data, timingInterval, 99.9)),
+            static_cast<long long>(maximum));
+        if (written < 0 || written >= bufferSize) {
+            // out of room, keep what fit
+            return writtenTotal + (bufferSize > 0 ? bufferSize - 1 : 0);
+        }
         buffer += written;
         bufferSize -= written;
         writtenTotal += written;
@@ -68,11 +201,156 @@ int profiling_time_print(TimingData* data, char* buffer, int bufferSize)
     return writtenTotal;
 }
 
+const char* profiling_interval_name(TimingInterval interval)
+{
+    return interval < TimingIntervalCount ? sIntervalNames[interval].data() : "?";
+}
+
 void profiling_time_clear(struct TimingData* data)
 {
-    std::unique_lock lock{Mutex};
-    std::memset(data->intervals, 0, TimingIntervalCount * sizeof(int64_t));
-    std::memset(data->intervalCount, 0, TimingIntervalCount * sizeof(int));
+    for (int interval = 0; interval < TimingIntervalCount; ++interval)
+    {
+        std::atomic_ref(data->intervals[interval]).store(0, std::memory_order_relaxed);
+        std::atomic_ref(data->intervalCount[interval]).store(0, std::memory_order_relaxed);
+        std::atomic_ref(data->intervalMinFromTop[interval]).store(0, std::memory_order_relaxed);
+        std::atomic_ref(data->intervalMax[interval]).store(0, std::memory_order_relaxed);
+        for (unsigned& bucket : data->histograms[interval]) {
+            std::atomic_ref(bucket).store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void profiling_trace_set_enabled(int enabled)
+{
+    sTraceEnabled.store(enabled != 0, std::memory_order_relaxed);
+}
+
+void profiling_trace_name_thread(const char* name)
+{
+    const uint32_t id = traceThreadId();
+    if (id > TraceThreadNameCount)
+        return;
+    auto& destination = sTraceThreadNames[id - 1];
+    size_t i = 0;
+    for (; i + 1 < destination.size() && name[i]; ++i) {
+        destination[i].store(name[i], std::memory_order_relaxed);
+    }
+    destination[i].store('\0', std::memory_order_relaxed);
+}
+
+// a JSON string with its quotes, so names with quotes, backslashes or control characters stay valid
+internalfunc void writeJsonString(FILE* file, const char* text)
+{
+    std::fputc('"', file);
+    for (; *text; ++text) {
+        const unsigned char c = static_cast<unsigned char>(*text);
+        if (c == '"' || c == '\\') {
+            std::fputc('\\', file);
+            std::fputc(c, file);
+        } else if (c < 0x20) {
+            std::fprintf(file, "\\u%04x", c);
+        } else {
+            std::fputc(c, file);
+        }
+    }
+    std::fputc('"', file);
+}
+
+int profiling_trace_write_json(const char* filename)
+{
+    FILE* file = std::fopen(filename, "w");
+    if (!file)
+        return -1;
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    const char* separator = "";
+    const uint32_t threadCount = sTraceThreadCount.load(std::memory_order_relaxed);
+    for (uint32_t id = 1; id <= threadCount && id <= TraceThreadNameCount; ++id) {
+        char name[TraceThreadNameLength];
+        for (size_t i = 0; i < sizeof(name); ++i) {
+            name[i] = sTraceThreadNames[id - 1][i].load(std::memory_order_relaxed);
+        }
+        name[sizeof(name) - 1] = '\0';
+        if (name[0]) {
+            std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                         separator, id);
+            writeJsonString(file, name);
+            std::fprintf(file, "}}");
+            separator = ",\n";
+        }
+    }
+
+    const uint64_t head = sTraceHead.load(std::memory_order_acquire);
+    const uint64_t first = head > TimingTraceCapacity ? head - TimingTraceCapacity : 0;
+    int written = 0;
+    for (uint64_t sequence = first; sequence < head; ++sequence) {
+        const TraceEvent& event = sTraceEvents[sequence % TimingTraceCapacity];
+        if (event.sequence.load(std::memory_order_acquire) != sequence + 1)
+            continue;
+        const int64_t start = event.start.load(std::memory_order_relaxed);
+        const int64_t end = event.end.load(std::memory_order_relaxed);
+        const uint32_t threadId = event.threadId.load(std::memory_order_relaxed);
+        const uint32_t interval = event.interval.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // overwritten while we were reading it
+        if (event.sequence.load(std::memory_order_relaxed) != sequence + 1 || interval >= TimingIntervalCount)
+            continue;
+        std::fprintf(file, "%s{\"name\":", separator);
+        writeJsonString(file, sIntervalNames[interval].data());
+        std::fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%lld,\"dur\":%lld}",
+                     threadId, static_cast<long long>(start), static_cast<long long>(end - start));
+        separator = ",\n";
+        ++written;
+    }
+    std::fprintf(file, "\n]}\n");
+    // a failed write anywhere above leaves the error flag set, a cut off trace is no trace
+    const bool failed = std::ferror(file) != 0;
+    if (std::fclose(file) != 0 || failed)
+        return -1;
+    return written;
+}
+
+void profiling_trace_clear(void)
+{
+    for (auto& event : sTraceEvents) {
+        event.sequence.store(0, std::memory_order_relaxed);
+    }
+    sTraceHead.store(0, std::memory_order_release);
+}
+
+// Written by the audio thread alone, which hands a copy to the printing thread after every
+// buffer, so neither of them ever waits for the other.
+static AudioDeadlines::Monitor sAudioDeadlines{};
+static TripleBuffer<AudioDeadlines::Monitor> sAudioDeadlinesPublished{};
+
+int64_t profiling_audio_now_ns(void)
+{
+    return AudioDeadlines::now_ns();
+}
+
+void profiling_audio_start(int64_t streamStart_ns, double sampleRate)
+{
+    sAudioDeadlines.start(streamStart_ns, sampleRate);
+    sAudioDeadlinesPublished.reset();
+}
+
+void profiling_audio_record(double sampleTime, int64_t callStart_ns, int64_t callEnd_ns, int64_t lockWait_ns)
+{
+    sAudioDeadlines.record(sampleTime, callStart_ns, callEnd_ns, lockWait_ns);
+    sAudioDeadlinesPublished.back() = sAudioDeadlines;
+    sAudioDeadlinesPublished.publish();
+}
+
+int profiling_audio_print(char* buffer, int bufferSize)
+{
+    const AudioDeadlines::Monitor* monitor = sAudioDeadlinesPublished.latest();
+    if (!monitor) {
+        if (bufferSize > 0) {
+            buffer[0] = '\0';
+        }
+        return 0;
+    }
+    return monitor->print(buffer, bufferSize);
 }
 
 #else
@@ -83,5 +361,30 @@ void profiling_time_set(TimingData*, TimingTimer) {}
 
 void profiling_time_interval(TimingData*, TimingTimer, TimingInterval) {}
 
+int64_t profiling_time_percentile(TimingData*, TimingInterval, double) { return 0; }
+
+const char* profiling_interval_name(TimingInterval) { return ""; }
+
+void profiling_trace_set_enabled(int) {}
+
+void profiling_trace_name_thread(const char*) {}
+
+int profiling_trace_write_json(const char*) { return 0; }
+
+void profiling_trace_clear(void) {}
+
+int64_t profiling_audio_now_ns(void) { return 0; }
+
+void profiling_audio_start(int64_t, double) {}
+
+void profiling_audio_record(double, int64_t, int64_t, int64_t) {}
+
+int profiling_audio_print(char* buffer, int bufferSize) {
+    if (bufferSize > 0) {
+        buffer[0] = '\0';
+    }
+    return 0;
+}
+
 #endif
 }
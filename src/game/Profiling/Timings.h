@@ -35,9 +35,20 @@ enum TimingInterval {
     eTimingDrawWaitAndSetup,
     eTimingDrawEncoding,
     eTimingDrawPresent,
+    eTimingRewindSnapshot,
     TimingIntervalCount
 };
 
+// Latency histogram buckets: exact below 8 us, then 8 buckets per power of two (within 12.5%)
+// up to about 35 minutes, longer intervals land in the last bucket.
+enum {
+    TimingHistogramSubBucketBits = 3,
+    TimingHistogramBucketCount = 232
+};
+
+// profiling_time_print writes one line per interval, this always fits
+enum { TimingPrintBufferSize = 2048 };
+
 typedef int64_t (*PlatformTimeMicrosecondsCallback)();
 
 struct TimingData {
@@ -45,6 +56,10 @@ struct TimingData {
     int64_t timers[TimingTimerCount];
     int64_t intervals[TimingIntervalCount];
     int intervalCount[TimingIntervalCount];
+    // INT64_MAX minus the shortest interval, so a zeroed struct starts out right
+    int64_t intervalMinFromTop[TimingIntervalCount];
+    int64_t intervalMax[TimingIntervalCount];
+    unsigned histograms[TimingIntervalCount][TimingHistogramBucketCount];
 } CF_SWIFT_NAME(ProfilingTime);
 
 
@@ -56,10 +71,40 @@ void profiling_time_set(struct TimingData* data, enum TimingTimer timer)
     CF_SWIFT_NAME(ProfilingTime.startTimer(self:_:));
 void profiling_time_interval(struct TimingData* data, enum TimingTimer timer, enum TimingInterval interval)
     CF_SWIFT_NAME(ProfilingTime.interval(self:timer:interval:));
+// one line per interval: name, count, mean, min, p50, p90, p99, p99.9 and max in microseconds
 int profiling_time_print(struct TimingData* data, char* buffer, int bufferSize)
     CF_SWIFT_NAME(ProfilingTime.printTo(self:buffer:size:));
+// upper edge of the histogram bucket holding the given percentile (0 to 100), clamped to min and max
+int64_t profiling_time_percentile(struct TimingData* data, enum TimingInterval interval, double percentile)
+    CF_SWIFT_NAME(ProfilingTime.percentile(self:interval:_:));
 void profiling_time_clear(struct TimingData* data)
     CF_SWIFT_NAME(ProfilingTime.clear(self:));
+// the name profiling_time_print uses for the interval
+const char* profiling_interval_name(enum TimingInterval interval);
+
+// Every profiling_time_interval also lands in a process wide ring buffer as one
+// event with its start, end and thread, keeping the newest TimingTraceCapacity.
+enum { TimingTraceCapacity = 1 << 15 };
+
+// recording is on by default
+void profiling_trace_set_enabled(int enabled);
+// shows up as the name of the calling thread's track in the trace
+void profiling_trace_name_thread(const char* name);
+// writes the events in the ring as Chrome trace event JSON (chrome://tracing, ui.perfetto.dev),
+// returns the number of events written or -1 if the file could not be opened or written
+int profiling_trace_write_json(const char* filename);
+void profiling_trace_clear(void);
+
+// Audio deadlines, see AudioDeadlines.hpp: the audio thread records every writeAudioBuffer call
+// with the times it really started and ended, and any one other thread may print the summary.
+// Times are nanoseconds of profiling_audio_now_ns().
+int64_t profiling_audio_now_ns(void);
+// once, before the first record: sample 0 of the stream starts playing at streamStart_ns
+void profiling_audio_start(int64_t streamStart_ns, double sampleRate);
+// the call that wrote the buffer starting at sampleTime, lockWait_ns is lastAudioBufferLockWait() after it
+void profiling_audio_record(double sampleTime, int64_t callStart_ns, int64_t callEnd_ns, int64_t lockWait_ns);
+// the summary as of the last recorded buffer, nothing before the first
+int profiling_audio_print(char* buffer, int bufferSize);
 
 
 #ifdef __cplusplus
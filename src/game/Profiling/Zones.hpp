@@ -0,0 +1,243 @@
+//
+//  Zones.hpp
+//  Project256
+//
+//  Named, nestable profiling zones for game code. Put PROFILE_ZONE("name") or
+//  PROFILE_FUNCTION() at the top of a scope: the zone registers itself the first
+//  time it runs, remembers which zone it was nested in, and adds its time to the
+//  current frame until endFrame() rolls the frame into the totals.
+//
+//  Build with PROFILING_ZONES=0 and the zones are gone: the macros expand to
+//  nothing, there is no registry, and endFrame(), clear() and print() do nothing.
+//
+
+#pragma once
+
+#ifndef PROFILING_ZONES
+#define PROFILING_ZONES 1
+#endif
+
+#include "../defines.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#if PROFILING_ZONES
+
+namespace ProfilingZones {
+
+compiletime uint32_t MaxZones = 128;
+compiletime uint32_t NoZone = UINT32_MAX;
+// registered, but did not run yet
+compiletime uint32_t Unplaced = NoZone - 1;
+
+struct Zone {
+    std::atomic<const char*> name;
+    // the zone this one ran inside of the first time, NoZone at the top
+    std::atomic<uint32_t> parent;
+
+    // the frame in progress
+    std::atomic<uint64_t> frameCalls;
+    std::atomic<uint64_t> frameInclusive_ns;
+    std::atomic<uint64_t> frameChildren_ns;
+
+    // finished frames, only written by endFrame()
+    std::atomic<uint64_t> totalCalls;
+    std::atomic<uint64_t> totalInclusive_ns;
+    std::atomic<uint64_t> totalChildren_ns;
+    std::atomic<uint64_t> maxFrameInclusive_ns;
+};
+
+struct Registry {
+    std::array<Zone, MaxZones> zones;
+    std::atomic<uint32_t> zoneCount;
+    std::atomic<uint64_t> frameCount;
+};
+
+inline Registry& registry() {
+    localpersist Registry instance{};
+    return instance;
+}
+
+// called once per zone through a function local static, returns NoZone when full
+inline uint32_t registerZone(const char* name) {
+    auto& reg = registry();
+    uint32_t id = reg.zoneCount.load(std::memory_order_relaxed);
+    do {
+        if (id >= MaxZones)
+            return NoZone;
+    } while (!reg.zoneCount.compare_exchange_weak(id, id + 1, std::memory_order_relaxed));
+    Zone& zone = reg.zones[id];
+    zone.parent.store(Unplaced, std::memory_order_relaxed);
+    // readers skip zones without a name
+    zone.name.store(name, std::memory_order_release);
+    return id;
+}
+
+inline uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+struct ScopedZone;
+inline thread_local ScopedZone* currentScope = nullptr;
+
+struct ScopedZone {
+    uint32_t id;
+    ScopedZone* outer;
+    uint64_t start_ns;
+    uint64_t children_ns = 0;
+
+    explicit ScopedZone(uint32_t zoneId) : id(zoneId), outer(currentScope) {
+        if (id == NoZone)
+            return;
+        // the first run decides where the zone sits in the tree
+        uint32_t unset = Unplaced;
+        registry().zones[id].parent.compare_exchange_strong(unset, outer ? outer->id : NoZone, std::memory_order_relaxed);
+        currentScope = this;
+        start_ns = now_ns();
+    }
+
+    ~ScopedZone() {
+        if (id == NoZone)
+            return;
+        const uint64_t elapsed = now_ns() - start_ns;
+        Zone& zone = registry().zones[id];
+        zone.frameCalls.fetch_add(1, std::memory_order_relaxed);
+        zone.frameInclusive_ns.fetch_add(elapsed, std::memory_order_relaxed);
+        zone.frameChildren_ns.fetch_add(children_ns, std::memory_order_relaxed);
+        if (outer) {
+            outer->children_ns += elapsed;
+        }
+        currentScope = outer;
+    }
+
+    ScopedZone(const ScopedZone&) = delete;
+    ScopedZone& operator=(const ScopedZone&) = delete;
+};
+
+// once per tick, zones that end on other threads count towards the frame they end in
+inline void endFrame() {
+    auto& reg = registry();
+    const uint32_t count = reg.zoneCount.load(std::memory_order_acquire);
+    for (uint32_t id = 0; id < count && id < MaxZones; ++id) {
+        Zone& zone = reg.zones[id];
+        const uint64_t inclusive = zone.frameInclusive_ns.exchange(0, std::memory_order_relaxed);
+        zone.totalCalls.fetch_add(zone.frameCalls.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        zone.totalInclusive_ns.fetch_add(inclusive, std::memory_order_relaxed);
+        zone.totalChildren_ns.fetch_add(zone.frameChildren_ns.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+        if (inclusive > zone.maxFrameInclusive_ns.load(std::memory_order_relaxed)) {
+            zone.maxFrameInclusive_ns.store(inclusive, std::memory_order_relaxed);
+        }
+    }
+    reg.frameCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline void clear() {
+    auto& reg = registry();
+    const uint32_t count = reg.zoneCount.load(std::memory_order_acquire);
+    for (uint32_t id = 0; id < count && id < MaxZones; ++id) {
+        Zone& zone = reg.zones[id];
+        zone.totalCalls.store(0, std::memory_order_relaxed);
+        zone.totalInclusive_ns.store(0, std::memory_order_relaxed);
+        zone.totalChildren_ns.store(0, std::memory_order_relaxed);
+        zone.maxFrameInclusive_ns.store(0, std::memory_order_relaxed);
+    }
+    reg.frameCount.store(0, std::memory_order_relaxed);
+}
+
+// one line per zone, children indented below their parent, times in microseconds per frame
+inline int print(char* buffer, int bufferSize) {
+    auto& reg = registry();
+    const uint32_t count = reg.zoneCount.load(std::memory_order_acquire);
+    const uint64_t frames = reg.frameCount.load(std::memory_order_relaxed);
+    const double perFrame = frames ? 1.0 / frames : 0.0;
+    int writtenTotal = 0;
+
+    auto printLine = [&](const char* format, auto... args) {
+        if (bufferSize <= 0)
+            return false;
+        const int written = std::snprintf(buffer, static_cast<size_t>(bufferSize), format, args...);
+        if (written < 0 || written >= bufferSize) {
+            writtenTotal += bufferSize - 1;
+            bufferSize = 0;
+            return false;
+        }
+        buffer += written;
+        bufferSize -= written;
+        writtenTotal += written;
+        return true;
+    };
+
+    if (!printLine("%-32s %8s %10s %10s %10s\n", "zone", "calls/f", "incl us/f", "self us/f", "max us/f"))
+        return writtenTotal;
+
+    // depth first from the roots
+    std::array<uint32_t, MaxZones> stack;
+    std::array<int, MaxZones> depths;
+    int top = 0;
+    for (uint32_t root = count; root-- > 0;) {
+        if (reg.zones[root].name.load(std::memory_order_acquire) && reg.zones[root].parent.load(std::memory_order_relaxed) >= count) {
+            stack[top] = root;
+            depths[top++] = 0;
+        }
+    }
+    while (top > 0) {
+        --top;
+        const uint32_t id = stack[top];
+        const int depth = depths[top];
+        const Zone& zone = reg.zones[id];
+        const uint64_t inclusive = zone.totalInclusive_ns.load(std::memory_order_relaxed);
+        const uint64_t children = zone.totalChildren_ns.load(std::memory_order_relaxed);
+        if (!printLine("%*s%-*s %8.2f %10.2f %10.2f %10.2f\n", depth * 2, "", 32 - depth * 2, zone.name.load(std::memory_order_relaxed),
+                       zone.totalCalls.load(std::memory_order_relaxed) * perFrame,
+                       inclusive * perFrame / 1000.0,
+                       (inclusive > children ? inclusive - children : 0) * perFrame / 1000.0,
+                       zone.maxFrameInclusive_ns.load(std::memory_order_relaxed) / 1000.0))
+            return writtenTotal;
+        for (uint32_t child = count; child-- > 0;) {
+            if (reg.zones[child].name.load(std::memory_order_acquire) && reg.zones[child].parent.load(std::memory_order_relaxed) == id
+                && top < static_cast<int>(MaxZones)) {
+                stack[top] = child;
+                depths[top++] = depth + 1;
+            }
+        }
+    }
+    return writtenTotal;
+}
+
+}
+
+#else
+
+namespace ProfilingZones {
+
+inline void endFrame() {}
+
+inline void clear() {}
+
+inline int print(char* buffer, int bufferSize) {
+    if (bufferSize > 0) {
+        buffer[0] = '\0';
+    }
+    return 0;
+}
+
+}
+
+#endif
+
+#define PROFILE_ZONE_CONCAT_(a, b) a##b
+#define PROFILE_ZONE_CONCAT(a, b) PROFILE_ZONE_CONCAT_(a, b)
+
+#if PROFILING_ZONES
+#define PROFILE_ZONE(name) \
+    localpersist const uint32_t PROFILE_ZONE_CONCAT(profileZoneId, __LINE__) = ProfilingZones::registerZone(name); \
+    const ProfilingZones::ScopedZone PROFILE_ZONE_CONCAT(profileZone, __LINE__){PROFILE_ZONE_CONCAT(profileZoneId, __LINE__)}
+#else
+#define PROFILE_ZONE(name)
+#endif
+
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
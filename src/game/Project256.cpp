@@ -1,12 +1,42 @@
 #include "Project256.h"
 #include "Utility/FrameInput.hpp"
 #include <cassert>
+#include <algorithm>
+#include "Drawing/DirtyRows.hpp"
+#include "Utility/WorkerPool.hpp"
+#include "Profiling/Zones.hpp"
+#include "Profiling/AudioDeadlines.hpp"
+#include "Profiling/MemoryReport.hpp"
 #include "TestBed.hpp"
 #include "Minesweeper.hpp"
 
 
-//using Game = TestBed;
+#ifdef GAME_TESTBED
+using Game = TestBed;
+#else
 using Game = Minesweeper;
+#endif
+
+// helps writeDrawBuffer, the platform decides how many threads it may have
+globalvar WorkerPool drawWorkers;
+// state of writeDrawBuffer alone, outside the game memory so rewinds and replays never see it
+globalvar PaletteExpansion::Expander drawExpander;
+// set once the first writeDrawBuffer picked the expansion kernels. Not at static initialisation:
+// every module load would pay for it, also a hot reload candidate that is then rejected.
+globalvar bool drawExpanderMeasured = false;
+
+// temporaries of a single doGameThings call
+constant size_t FrameArenaSize = 256 * 1024;
+
+// writeDrawBuffer only ever runs on one thread at a time, the flag needs no lock
+internalfunc PaletteExpansion::Expander& measuredDrawExpander()
+{
+    if (!drawExpanderMeasured) {
+        drawExpander.measure(DrawBufferWidth * DrawBufferHeight);
+        drawExpanderMeasured = true;
+    }
+    return drawExpander;
+}
 
 extern "C" {
 
@@ -92,8 +122,17 @@ GameOutput doGameThings(GameInput* pInput, void* pMemory, PlatformCallbacks plat
 
     auto& memory = *reinterpret_cast<Game::MemoryLayout*>(pMemory);
     auto& input = *reinterpret_cast<FrameInput::Input*>(pInput);
+    // the platform hands over a zeroed block, everything behind the layout belongs to the arena
+    if (!memory.arena.isInitialized()) {
+        memory.arena.init(reinterpret_cast<std::byte*>(pMemory) + sizeof(Game::MemoryLayout), MemorySize - sizeof(Game::MemoryLayout));
+        memory.frameArena = memory.arena.carve(FrameArenaSize);
+    }
+    // nothing allocated in the last tick survives into this one
+    memory.frameArena.reset();
 
-    return Game::doGameThings(memory, input, platform);
+    const auto output = Game::doGameThings(memory, input, platform);
+    ProfilingZones::endFrame();
+    return output;
 }
 
 void writeDrawBuffer(void* pMemory, void* buffer)
@@ -103,9 +142,118 @@ void writeDrawBuffer(void* pMemory, void* buffer)
 
     auto& memory = *reinterpret_cast<Game::MemoryLayout*>(pMemory);
     auto& drawBuffer = *reinterpret_cast<Game::DrawBuffer*>(buffer);
-    Game::writeDrawBuffer(memory, drawBuffer);
+    DirtyRows<DrawBufferHeight> changed{};
+    Game::writeDrawBuffer(memory, drawBuffer, changed, drawWorkers, measuredDrawExpander());
+}
+
+unsigned writeDrawBufferRows(void* pMemory, void* buffer, DrawBufferRows* spans, unsigned maxSpans)
+{
+    assert(buffer != nullptr);
+    assert(pMemory != nullptr);
+    assert(spans != nullptr);
+    assert(maxSpans > 0);
+
+    auto& memory = *reinterpret_cast<Game::MemoryLayout*>(pMemory);
+    auto& drawBuffer = *reinterpret_cast<Game::DrawBuffer*>(buffer);
+    DirtyRows<DrawBufferHeight> changed{};
+    Game::writeDrawBuffer(memory, drawBuffer, changed, drawWorkers, measuredDrawExpander());
+
+    // at worst every other row is dirty
+    std::array<DrawBufferRows, (DrawBufferHeight + 1) / 2> all;
+    unsigned count = 0;
+    changed.forEachSpan([&](size_t first, size_t rowCount) {
+        all[count++] = DrawBufferRows{ static_cast<unsigned>(first), static_cast<unsigned>(rowCount) };
+    });
+
+    // merge across the smallest gap until the spans fit, uploading a few clean rows is cheaper than another call
+    while (count > maxSpans) {
+        unsigned closest = 0;
+        unsigned smallestGap = DrawBufferHeight;
+        for (unsigned i = 0; i + 1 < count; ++i) {
+            const unsigned gap = all[i + 1].first - (all[i].first + all[i].count);
+            if (gap < smallestGap) {
+                smallestGap = gap;
+                closest = i;
+            }
+        }
+        all[closest].count = all[closest + 1].first + all[closest + 1].count - all[closest].first;
+        std::copy(all.begin() + closest + 2, all.begin() + count, all.begin() + closest + 1);
+        --count;
+    }
+    std::copy(all.begin(), all.begin() + count, spans);
+    return count;
+}
+
+void setDrawBufferThreadCount(unsigned threadCount)
+{
+    drawWorkers.start(threadCount);
+}
+
+void invalidateDrawBuffer(void* pMemory)
+{
+    assert(pMemory != nullptr);
+
+    auto& memory = *reinterpret_cast<Game::MemoryLayout*>(pMemory);
+    Game::invalidateDrawBuffer(memory);
+}
+
+int printMemoryLayout(void* pMemory, char* buffer, int bufferSize)
+{
+    assert(pMemory != nullptr);
+    assert(buffer != nullptr);
+
+    const auto& memory = *reinterpret_cast<const Game::MemoryLayout*>(pMemory);
+    MemoryReport::Report<> report{};
+    Game::describeMemory(memory, report);
+    const int written = report.print(buffer, bufferSize);
+    const int arenaWritten = std::snprintf(buffer + written, static_cast<size_t>(bufferSize - written),
+        "arena: %zu of %zu bytes in use, high water %zu bytes\n"
+        "frame arena: high water %zu of %zu bytes\n",
+        memory.arena.used, memory.arena.capacity, memory.arena.highWater,
+        memory.frameArena.highWater, memory.frameArena.capacity);
+    return arenaWritten < 0 ? written : written + std::min(arenaWritten, bufferSize - written - 1);
 }
 
+unsigned long long gameMemoryInUse(void* pMemory)
+{
+    assert(pMemory != nullptr);
+
+    const auto& memory = *reinterpret_cast<const Game::MemoryLayout*>(pMemory);
+    if (!memory.arena.isInitialized())
+        return sizeof(Game::MemoryLayout);
+    return static_cast<unsigned long long>(memory.arena.base - reinterpret_cast<const std::byte*>(pMemory)) + memory.arena.highWater;
+}
+
+unsigned long long gameMemoryLayoutHash(void* pMemory)
+{
+    assert(pMemory != nullptr);
+
+    // only takes the addresses of the members, the memory may be from an older version of the game
+    const auto& memory = *reinterpret_cast<const Game::MemoryLayout*>(pMemory);
+    MemoryReport::Report<> report{};
+    Game::describeMemory(memory, report);
+    // a member describeMemory() leaves out would not be part of the hash
+    assert(report.undescribedBytes() == 0);
+    return report.hash();
+}
+
+int printProfilingZones(char* buffer, int bufferSize)
+{
+    assert(buffer != nullptr);
+#if PROFILING_ZONES
+    return ProfilingZones::print(buffer, bufferSize);
+#else
+    if (bufferSize > 0) {
+        buffer[0] = '\0';
+    }
+    return 0;
+#endif
+}
+
+void clearProfilingZones(void)
+{
+    ProfilingZones::clear();
+}
 
 void writeAudioBuffer(void* pMemory, void* buffer, struct AudioBufferDescriptor bufferDescriptor)
 {
@@ -114,8 +262,14 @@ void writeAudioBuffer(void* pMemory, void* buffer, struct AudioBufferDescriptor
 
     auto& memory = *reinterpret_cast<Game::MemoryLayout*>(pMemory);
     auto& audioBuffer = *reinterpret_cast<Game::AudioBuffer*>(buffer);
+    AudioDeadlines::lastLockWait_ns.store(0, std::memory_order_relaxed);
     Game::writeAudioBuffer(memory, audioBuffer, bufferDescriptor);
     
 }
 
+long long lastAudioBufferLockWait(void)
+{
+    return AudioDeadlines::lastLockWait_ns.load(std::memory_order_relaxed);
+}
+
 }
@@ -165,6 +165,11 @@ struct AudioBufferDescriptor {
     unsigned channelsPerFrame;
 };
 
+// a run of consecutive rows in the draw buffer, counted in memory order
+struct DrawBufferRows {
+    unsigned first, count;
+};
+
 struct Rumble {
 	float left, right;
 };
@@ -180,8 +185,30 @@ struct GameOutput {
 struct Vec2f clipSpaceDrawBufferScale(unsigned int viewportWidth, unsigned int viewportHeight);
 void cleanInput(struct GameInput* input);
 struct GameOutput doGameThings(struct GameInput* input, void* memory, struct PlatformCallbacks callbacks);
+// the first call also times the palette expansion kernels, which takes a few milliseconds
 void writeDrawBuffer(void* memory, void* buffer);
+// like writeDrawBuffer, and reports the rows it changed so the platform can upload a partial texture.
+// Writes at most maxSpans spans, merging the closest neighbours to fit, and returns how many it wrote:
+// 0 when the buffer did not change.
+unsigned writeDrawBufferRows(void* memory, void* buffer, struct DrawBufferRows* spans, unsigned maxSpans);
+// how many threads writeDrawBuffer splits the buffer across, counting the calling one.
+// 1 is the default and never starts a thread, call it again with 1 to stop them.
+void setDrawBufferThreadCount(unsigned threadCount);
+// after the memory was put back to an earlier state, the draw buffer no longer matches what writeDrawBuffer
+// remembers about it: the next call expands everything again. No writeDrawBuffer may run meanwhile.
+void invalidateDrawBuffer(void* memory);
+// every member of the game's memory layout with its offset, size, padding, cache lines and threads
+int printMemoryLayout(void* memory, char* buffer, int bufferSize);
+// bytes at the start of the memory block the game has touched so far, the rest is still zero
+unsigned long long gameMemoryInUse(void* memory);
+// identifies the game's memory layout, a game module that hashes differently cannot take over the memory
+unsigned long long gameMemoryLayoutHash(void* memory);
+// the game's profiling zones as an indented tree, times per frame averaged since the last clear
+int printProfilingZones(char* buffer, int bufferSize);
+void clearProfilingZones(void);
 void writeAudioBuffer(void* memory, void* buffer, struct AudioBufferDescriptor bufferDescriptor);
+// nanoseconds the last writeAudioBuffer call waited for state it shares with doGameThings
+long long lastAudioBufferLockWait(void);
 
 #ifdef __cplusplus
 }
@@ -16,11 +16,19 @@
 #include "Utility/Timers.hpp"
 #include "Utility/Text.hpp"
 #include "Utility/FrameInput.hpp"
+#include "Utility/TripleBuffer.hpp"
+#include "Utility/WorkerPool.hpp"
+#include "Utility/Arena.hpp"
+#include "Profiling/AudioDeadlines.hpp"
+#include "Profiling/MemoryReport.hpp"
 #include "Drawing/Images.hpp"
+#include "Drawing/DirtyRows.hpp"
+#include "Drawing/PaletteExpansion.hpp"
 #include "Drawing/Palettes.hpp"
 #include "Drawing/Generators.hpp"
 #include "Project256.h"
 #include <mutex>
+#include <cstring>
 
 #include <iostream>
 
@@ -34,12 +42,18 @@ constant int TextLines = DrawBufferHeight / TextCharacterH;
 constant int TextLineLength = DrawBufferWidth / TextCharacterW;
 
 
+// guards the state shared by doGameThings and writeAudioBuffer, video goes through TestBedMemory::frames
 globalvar std::mutex memoryMutex;
 
-struct TestBedMemory {
-    // video
+struct TestBedFrame {
     alignas(128) VRAM vram;
     alignas(128) std::array<uint32_t, 256> palette;
+};
+
+struct TestBedMemory {
+    // video, doGameThings draws into frames.back() and writeDrawBuffer expands frames.latest()
+    alignas(128) TripleBuffer<TestBedFrame> frames;
+    std::array<uint32_t, 256> palette;
 
     // images
     alignas(8) Image<uint8_t, 320, 256, ImageOrigin::TopLeft> imageDecoded;
@@ -81,8 +95,11 @@ struct TestBedMemory {
     // mouse clicks
     Vec2i mouseDownPosition;
     bool isMouseDown;
-    
-    std::array<uint8_t, 300 * 1024> scratch;
+
+    // the rest of the memory block, loading assets takes its temporaries from here
+    Arena arena;
+    // out of arena, emptied before every tick
+    Arena frameArena;
 };
 
 
@@ -98,8 +115,66 @@ struct TestBed {
     using AudioBuffer = Audio::PCM16StereoBuffer<AudioFramesPerBuffer>;
     using MemoryLayout = TestBedMemory;
 
+    // bump when the inside of a member's type changes, the hash of describeMemory() only sees its name and size
+    compiletime uint32_t MemoryLayoutVersion = 1;
+
+    static void describeMemory(const MemoryLayout& memory, MemoryReport::Report<>& report)
+    {
+        using namespace MemoryReport;
+        static_assert(coversLayout(&TestBedMemory::frames, &TestBedMemory::palette, &TestBedMemory::imageDecoded,
+                                   &TestBedMemory::faubigDecoded, &TestBedMemory::faufauDecoded, &TestBedMemory::tone,
+                                   &TestBedMemory::sequencer, &TestBedMemory::drumSequencer, &TestBedMemory::pewpew,
+                                   &TestBedMemory::envelope, &TestBedMemory::delay, &TestBedMemory::voice, &TestBedMemory::isInitialized,
+                                   &TestBedMemory::characterROM, &TestBedMemory::textBuffer, &TestBedMemory::textColors,
+                                   &TestBedMemory::textFirstLine, &TestBedMemory::textLastLine, &TestBedMemory::textScroll,
+                                   &TestBedMemory::textCursorPosition, &TestBedMemory::timerCursorBlink, &TestBedMemory::isCursorOn,
+                                   &TestBedMemory::birdPosition, &TestBedMemory::birdSpeed, &TestBedMemory::birdTarget,
+                                   &TestBedMemory::directionChangeTimer, &TestBedMemory::timerCallback, &TestBedMemory::sprite,
+                                   &TestBedMemory::spriteAnimationTimer, &TestBedMemory::currentSpriteFrame,
+                                   &TestBedMemory::mouseDownPosition, &TestBedMemory::isMouseDown, &TestBedMemory::arena,
+                                   &TestBedMemory::frameArena),
+                      "every member of TestBedMemory needs a line below");
+        report.begin(memory, MemoryLayoutVersion);
+        report.add("frames", memory, memory.frames, TickThread | DrawThread);
+        report.add("palette", memory, memory.palette, TickThread);
+        report.add("imageDecoded", memory, memory.imageDecoded, TickThread);
+        report.add("faubigDecoded", memory, memory.faubigDecoded, TickThread);
+        report.add("faufauDecoded", memory, memory.faufauDecoded, TickThread);
+        report.add("tone", memory, memory.tone, TickThread | AudioThread);
+        report.add("sequencer", memory, memory.sequencer, TickThread | AudioThread);
+        report.add("drumSequencer", memory, memory.drumSequencer, TickThread | AudioThread);
+        report.add("pewpew", memory, memory.pewpew, TickThread | AudioThread);
+        report.add("envelope", memory, memory.envelope, TickThread | AudioThread);
+        report.add("delay", memory, memory.delay, TickThread | AudioThread);
+        report.add("voice", memory, memory.voice, TickThread | AudioThread);
+        report.add("isInitialized", memory, memory.isInitialized, TickThread | AudioThread);
+        report.add("characterROM", memory, memory.characterROM, TickThread);
+        report.add("textBuffer", memory, memory.textBuffer, TickThread);
+        report.add("textColors", memory, memory.textColors, TickThread);
+        report.add("textFirstLine", memory, memory.textFirstLine, TickThread);
+        report.add("textLastLine", memory, memory.textLastLine, TickThread);
+        report.add("textScroll", memory, memory.textScroll, TickThread);
+        report.add("textCursorPosition", memory, memory.textCursorPosition, TickThread);
+        report.add("timerCursorBlink", memory, memory.timerCursorBlink, TickThread);
+        report.add("isCursorOn", memory, memory.isCursorOn, TickThread);
+        report.add("birdPosition", memory, memory.birdPosition, TickThread);
+        report.add("birdSpeed", memory, memory.birdSpeed, TickThread);
+        report.add("birdTarget", memory, memory.birdTarget, TickThread);
+        report.add("directionChangeTimer", memory, memory.directionChangeTimer, TickThread);
+        report.add("timerCallback", memory, memory.timerCallback, TickThread);
+        report.add("sprite", memory, memory.sprite, TickThread);
+        report.add("spriteAnimationTimer", memory, memory.spriteAnimationTimer, TickThread);
+        report.add("currentSpriteFrame", memory, memory.currentSpriteFrame, TickThread);
+        report.add("mouseDownPosition", memory, memory.mouseDownPosition, TickThread);
+        report.add("isMouseDown", memory, memory.isMouseDown, TickThread);
+        report.add("arena", memory, memory.arena, TickThread);
+        report.add("frameArena", memory, memory.frameArena, TickThread);
+        report.end();
+    }
+
     static GameOutput doGameThings(TestBedMemory& memory, const FrameInput::Input& input, const PlatformCallbacks& callbacks)
     {
+        PROFILE_ZONE("TestBed::doGameThings");
         if (input.frameNumber == 0) {
 #ifdef DEBUG
  //           test_myCos();
@@ -113,10 +188,19 @@ struct TestBed {
         using Text = CharacterRom::PET;
         const auto time = std::chrono::microseconds(input.upTime_microseconds);
 
-        auto lock = std::scoped_lock(memoryMutex);
         // initialize main memory
         if (input.frameNumber == 0) {
-            std::memset(&memory, 0, sizeof(TestBedMemory));
+            auto lock = std::scoped_lock(memoryMutex);
+            // the arenas were set up by the caller, loading only takes temporaries from them
+            const Arena arena = memory.arena;
+            const Arena frameArena = memory.frameArena;
+            // everything after frames, whose atomic writeDrawBuffer may be reading on the draw thread without the lock
+            static_assert(offsetof(TestBedMemory, frames) == 0);
+            std::byte* const afterFrames = reinterpret_cast<std::byte*>(&memory) + sizeof(memory.frames);
+            std::memset(afterFrames, 0, sizeof(TestBedMemory) - sizeof(memory.frames));
+            memory.arena = arena;
+            memory.frameArena = frameArena;
+            memory.frames.reset();
 
             std::memset(memory.palette.data(), 0xFF, memory.palette.size() * 4);
             Palette::writeTo(memory.palette.data());
@@ -153,9 +237,16 @@ struct TestBed {
             memory.textBuffer.at(4) = static_cast<uint8_t>(Text::SpecialCharacters::HLine);
             memory.textBuffer.at(5) = static_cast<uint8_t>(Text::SpecialCharacters::ArcDownLeft);
 
+            auto loadFile = [&](const char* filename) {
+                const auto read = callbacks.readFile(filename, reinterpret_cast<unsigned char*>(memory.arena.top()), static_cast<long long>(memory.arena.remaining()));
+                auto* data = memory.arena.allocateArray<uint8_t>(static_cast<size_t>(read > 0 ? read : 0), 1);
+                assert(data != nullptr);
+                return ILBMDataParser<endian::big>{.data = data, .dataSize = static_cast<int>(read)};
+            };
+
             {
-                size_t read = callbacks.readFile("Faufau.brush", memory.scratch.data(), memory.scratch.size());
-                ILBMDataParser<endian::big> parser{.data = memory.scratch.data(), .dataSize = static_cast<int>(read)};
+                ArenaScope temporary(memory.arena);
+                auto parser = loadFile("Faufau.brush");
                 assert(parser.isValid());
                 auto colorMap = parser.getColorMap();
                 for (int i = 0; i < colorMap.size; ++i) {
@@ -166,21 +257,26 @@ struct TestBed {
             }
 
             {
-                size_t read = callbacks.readFile("Faufau.ilbm", memory.scratch.data(), memory.scratch.size());
-                ILBMDataParser<endian::big> parser{.data = memory.scratch.data(), .dataSize = static_cast<int>(read)};
+                ArenaScope temporary(memory.arena);
+                auto parser = loadFile("Faufau.ilbm");
                 parser.inflateAndDeinterleaveInto(memory.faubigDecoded.data(), memory.faubigDecoded.size(), memory.faubigDecoded.pitch());
             }
 
 
-            if (callbacks.readImage) {
-                if (!callbacks.readImage("test.bmp", reinterpret_cast<uint32_t*>(memory.scratch.data()), 320, 256))
-                     exit(3);
-            }
-            else {
-                exit(4);
-            }
+            {
+                ArenaScope temporary(memory.arena);
+                auto* bitmap = memory.arena.allocateArray<uint32_t>(320 * 256);
+                assert(bitmap != nullptr);
+                if (callbacks.readImage) {
+                    if (!callbacks.readImage("test.bmp", bitmap, 320, 256))
+                         exit(3);
+                }
+                else {
+                    exit(4);
+                }
 
-            ConvertBitmapFrom32BppToIndex<320>(reinterpret_cast<uint32_t*>(memory.scratch.data()), 320, 256, memory.palette, memory.imageDecoded.data());
+                ConvertBitmapFrom32BppToIndex<320>(bitmap, 320, 256, memory.palette, memory.imageDecoded.data());
+            }
 
             memory.tone.depth = .5f;
             memory.tone.mod.amplitude = 1.0f;
@@ -245,10 +341,14 @@ struct TestBed {
         constant auto lightBlue = static_cast<VRAM::PixelType>(findNearest(WebColorRGB::LightBlue, memory.palette).index);
         constant auto red = static_cast<VRAM::PixelType>(findNearest(WebColorRGB::Red, memory.palette).index);
         constant auto green = static_cast<VRAM::PixelType>(findNearest(WebColorRGB::Green, memory.palette).index);
-        constant auto whitePixel = [&](const auto& p) { memory.vram.at(p) = white; };
-        constant auto redPixel = [&](const auto& p) { memory.vram.at(p) = red; };
-        constant auto greenPixel = [&](const auto& p) { memory.vram.at(p) = green; };
-        constant auto lightBluePixel = [&](const auto& p) { memory.vram.at(p) = lightBlue; };
+        auto& frame = memory.frames.back();
+        auto& vram = frame.vram;
+        frame.palette = memory.palette;
+
+        const auto whitePixel = [&](const auto& p) { vram.at(p) = white; };
+        const auto redPixel = [&](const auto& p) { vram.at(p) = red; };
+        const auto greenPixel = [&](const auto& p) { vram.at(p) = green; };
+        const auto lightBluePixel = [&](const auto& p) { vram.at(p) = lightBlue; };
 
         auto clearColor = black;
         if (input.closeRequested) {
@@ -267,22 +367,22 @@ struct TestBed {
         }
 
         // clear the screen
-        std::memset(memory.vram.data(), (uint8_t)clearColor, DrawBufferWidth * DrawBufferHeight);
+        std::memset(vram.data(), (uint8_t)clearColor, DrawBufferWidth * DrawBufferHeight);
 
         // draw the testimage
-        imageCopy(memory.imageDecoded, memory.vram);
+        imageCopy(memory.imageDecoded, vram);
 
         // draw the palette in the first rows
     //    for (int y = 0; y < memory.palette.size() / 2; ++y) {
     //    for (int x = 0; x < DrawBufferWidth; ++x) {
-    //        put(memory.vram.data(), Vec2i{ x, y }, (x * 16 / DrawBufferWidth) + y / 8 * 16);
+    //        put(vram.data(), Vec2i{ x, y }, (x * 16 / DrawBufferWidth) + y / 8 * 16);
     //    } }
 
         // draw faufau testimage
-        imageCopy(memory.faufauDecoded, memory.vram);
+        imageCopy(memory.faufauDecoded, vram);
 
         auto subImage = makeSubImage(memory.faufauDecoded, 0, 0, 16, 16);
-        auto subImage2 = makeSubImage(memory.vram, 100, 100, 16, 16);
+        auto subImage2 = makeSubImage(vram, 100, 100, 16, 16);
         imageBlitWithTransparentColor(subImage, subImage2, 0);
 
         if (!input.text.empty()) {
@@ -350,7 +450,7 @@ struct TestBed {
                                 memory.textBuffer[memory.textCursorPosition++] = *character;
                             }
                             else {
-                                char* printBuffer = reinterpret_cast<char*>(memory.scratch.data());
+                                char* printBuffer = memory.frameArena.allocateArray<char>(100);
                                 snprintf(printBuffer, 100, "No Character for Codepoint: U+%05x in String \"%s\"", static_cast<uint32_t>(codePoint), reinterpret_cast<const char*>(text.data()));
                                 callbacks.log(printBuffer);
                             }
@@ -386,7 +486,7 @@ struct TestBed {
 
             if (input.mouse.buttonLeft.endedDown) {
                 for (auto p : rectangleGenerator | atMouse | clipped)
-                    memory.vram.at(wrap(p)) = green;
+                    vram.at(wrap(p)) = green;
             }
             
             compiletime auto crossGenerator = concat(HLine{{-3, 0}, 7}, VLine{{0, -3}, 7});
@@ -427,6 +527,7 @@ struct TestBed {
         if (input.mouse.buttonLeft.transitionCount) {
             localpersist Note note[4] = {Note::A4, Note::C5, Note::E5, Note::G5};
             localpersist int currentNote = 0;
+            auto lock = std::scoped_lock(memoryMutex);
             if (input.mouse.buttonLeft.endedDown ) {
                 memory.voice.on(note[currentNote], 1.0f);
             }
@@ -504,13 +605,13 @@ struct TestBed {
         memory.birdPosition = memory.birdPosition + seconds * memory.birdSpeed * normalized(birdDistance);
         memory.birdPosition = clamp(memory.birdPosition, Vec2f{}, Vec2f{DrawBufferWidth - 1, DrawBufferHeight - 1});
 
-        memory.vram.at(memory.birdTarget) = lightBlue;
+        vram.at(memory.birdTarget) = lightBlue;
 
         // draw
-        blitSprite(memory.sprite, memory.currentSpriteFrame, memory.vram.data(), DrawBufferWidth, truncate(memory.birdPosition), Vec2i{}, Vec2i{DrawBufferWidth, DrawBufferHeight});
+        blitSprite(memory.sprite, memory.currentSpriteFrame, vram.data(), DrawBufferWidth, truncate(memory.birdPosition), Vec2i{}, Vec2i{DrawBufferWidth, DrawBufferHeight});
 
         // draw text buffer
-        uint8_t* drawPointer = memory.vram.line(memory.vram.height() - TextCharacterH).data();
+        uint8_t* drawPointer = vram.line(vram.height() - TextCharacterH).data();
         uint8_t* textPointer = memory.textBuffer.data();
         uint8_t* textColorPointer = memory.textColors.data();
 
@@ -548,55 +649,35 @@ struct TestBed {
             (Rectangle{{cursorX * TextCharacterW, cursorY * TextCharacterH}, {(cursorX + 1) * TextCharacterW - 1, (cursorY + 1) * TextCharacterH - 1}} | forEach(whitePixel)).run();
         }
 
+        memory.frames.publish();
         return output;
     }
 
-    static void writeDrawBuffer(TestBedMemory& memory, DrawBuffer& buffer) {
-        auto lock = std::scoped_lock(memoryMutex);
-        if (!memory.isInitialized) return;
-        uint8_t* vram = memory.vram.data();
+    static void writeDrawBuffer(TestBedMemory& memory, DrawBuffer& buffer, DirtyRows<DrawBufferHeight>& changed, WorkerPool& workers,
+                                PaletteExpansion::Expander& expander) {
+        PROFILE_ZONE("TestBed::writeDrawBuffer");
+        // never blocks, expands whatever frame the tick published last
+        const TestBedFrame* frame = memory.frames.latest();
+        if (!frame) return;
+        // the tick redraws everything, so there is nothing to gain from tracking rows
+        changed.markAll();
+
+        static_assert(VRAM{}.pitch() == DrawBuffer{}.pitch() && VRAM{}.height() == DrawBuffer{}.height());
+        const uint8_t* vram = frame->vram.data();
         uint32_t* drawBuffer = buffer.data();
+        expander.prepare(frame->palette.data(), frame->palette.size());
 
-        constant auto stride = sizeof(uint64_t);
-        constant auto width = DrawBuffer{}.width();
-        constant auto height = DrawBuffer{}.height();
-        constant auto destpitch = DrawBuffer{}.pitch();
-        constant auto vrampitch = decltype(memory.vram){}.pitch();
-        if constexpr (width % stride == 0)
-        {
-            const uint32_t* palette = memory.palette.data();
-            for (uint32_t y = 0; y < height; ++y) {
-                uint64_t* src = reinterpret_cast<uint64_t*>(vram + y * vrampitch);
-                uint64_t* dst = reinterpret_cast<uint64_t*>(drawBuffer + y * destpitch);
-                for (uint32_t x = 0; x < width; x += stride) {
-                    const uint64_t sourcePixel8 = *src++;
-
-                    dst[0] = static_cast<uint64_t>(palette[sourcePixel8 >> 0 & 0xff]) |
-                        static_cast<uint64_t>(palette[sourcePixel8 >> 8 & 0xff]) << 32;
-                    dst[1] = static_cast<uint64_t>(palette[sourcePixel8 >> 16 & 0xff]) |
-                        static_cast<uint64_t>(palette[sourcePixel8 >> 24 & 0xff]) << 32;
-                    dst[2] = static_cast<uint64_t>(palette[sourcePixel8 >> 32 & 0xff]) |
-                        static_cast<uint64_t>(palette[sourcePixel8 >> 40 & 0xff]) << 32;
-                    dst[3] = static_cast<uint64_t>(palette[sourcePixel8 >> 48 & 0xff]) |
-                        static_cast<uint64_t>(palette[sourcePixel8 >> 56 & 0xff]) << 32;
-                    dst += 4;
-                }
-            }
-        }
-        else {
-            uint32_t* pixel = buffer.data();
-
-            for (unsigned y = 0; y < DrawBufferHeight; ++y)
-            for (unsigned x = 0; x < DrawBufferWidth; ++x)
-                *pixel++ = memory.palette[*vram++];
-        }
+        expander.expandRows(workers, vram, drawBuffer, VRAM{}.pitch(), 0, VRAM{}.height());
     }
 
+    // writeDrawBuffer expands the whole latest frame every time anyway
+    static void invalidateDrawBuffer(TestBedMemory& /*memory*/) {}
+
 
 
     static void writeAudioBuffer(TestBedMemory& memory, AudioBuffer& buffer, const AudioBufferDescriptor& bufferDescriptor) {
 
-        auto lock = std::scoped_lock(memoryMutex);
+        auto lock = AudioDeadlines::lockMeasuringWait(memoryMutex);
         if (!memory.isInitialized) {
             buffer.clear();
             return;
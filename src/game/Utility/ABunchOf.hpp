@@ -3,6 +3,8 @@
 #include <array>
 #include <numeric>
 #include <cassert>
+#include <cstdint>
+#include <utility>
 
 
 template<typename T, size_t N>
@@ -76,3 +78,138 @@ struct ABunchOf {
         return N;
     }
 };
+
+
+// Refers to an element of an APackedBunchOf. Freeing the element makes every handle to it
+// stale, also once the slot holds another element. The default handle is never valid.
+struct BunchHandle {
+    uint32_t slot = 0;
+    uint32_t generation = 0;
+
+    constexpr bool operator==(const BunchHandle&) const = default;
+};
+
+// Like ABunchOf, with the live elements packed at the front of one array: iterating them
+// reads count elements in a row, whatever the slots they were inserted at. Freeing moves
+// the last element into the gap, which changes the order, so free while walking from the back.
+template<typename T, size_t N>
+struct APackedBunchOf {
+    static_assert(N < UINT32_MAX, "slots are counted in 32 bits");
+
+    using Handle = BunchHandle;
+
+    std::size_t count = 0;
+    std::array<T, N> dense = {};
+    // the slot of each element in dense
+    std::array<uint32_t, N> denseSlot = {};
+    // where a live slot's element is in dense, for free slots the next free one
+    std::array<uint32_t, N> slotIndex = {};
+    // a slot's handles are valid while their generation matches, freeing bumps it. Always odd,
+    // so it never wraps around to the 0 of the default handle.
+    std::array<uint32_t, N> generations = {};
+    uint32_t freeSlot = 0;
+
+    constexpr APackedBunchOf() {
+        reset();
+    }
+
+    // frees everything, the handles handed out so far stay stale
+    constexpr void reset() {
+        count = 0;
+        freeSlot = 0;
+        for (uint32_t slot = 0; slot < N; ++slot) {
+            slotIndex[slot] = slot + 1;
+            generations[slot] += 1 + (generations[slot] & 1);
+        }
+    }
+
+    constexpr Handle insert(T&& value) {
+        assert(count != N && "container is full");
+
+        const uint32_t slot = freeSlot;
+        freeSlot = slotIndex[slot];
+        dense[count] = std::move(value);
+        denseSlot[count] = slot;
+        slotIndex[slot] = static_cast<uint32_t>(count);
+        ++count;
+        return { slot, generations[slot] };
+    }
+
+    constexpr bool contains(Handle handle) const {
+        // a free slot's generation was not handed out yet
+        return handle.slot < N && generations[handle.slot] == handle.generation;
+    }
+
+    // the element, nullptr for stale handles
+    constexpr T* get(Handle handle) {
+        return contains(handle) ? &dense[slotIndex[handle.slot]] : nullptr;
+    }
+
+    constexpr const T* get(Handle handle) const {
+        return contains(handle) ? &dense[slotIndex[handle.slot]] : nullptr;
+    }
+
+    constexpr T& operator[](Handle handle) {
+        assert(contains(handle) && "handle is stale");
+        return dense[slotIndex[handle.slot]];
+    }
+
+    constexpr const T& operator[](Handle handle) const {
+        assert(contains(handle) && "handle is stale");
+        return dense[slotIndex[handle.slot]];
+    }
+
+    // returns false and changes nothing for stale handles
+    constexpr bool free(Handle handle) {
+        if (!contains(handle))
+            return false;
+
+        const uint32_t index = slotIndex[handle.slot];
+        const size_t last = count - 1;
+        if (index != last) {
+            dense[index] = std::move(dense[last]);
+            denseSlot[index] = denseSlot[last];
+            slotIndex[denseSlot[index]] = index;
+        }
+        --count;
+
+        generations[handle.slot] += 2;
+        slotIndex[handle.slot] = freeSlot;
+        freeSlot = handle.slot;
+        return true;
+    }
+
+    // the handle of the element at a position in the packed order
+    constexpr Handle handleAt(size_t index) const {
+        assert((index < count) && "index out of range");
+        return { denseSlot[index], generations[denseSlot[index]] };
+    }
+
+    constexpr T* begin() {
+        return dense.data();
+    }
+
+    constexpr T* end() {
+        return dense.data() + count;
+    }
+
+    constexpr const T* begin() const {
+        return dense.data();
+    }
+
+    constexpr const T* end() const {
+        return dense.data() + count;
+    }
+
+    constexpr bool empty() const {
+        return count == 0;
+    }
+
+    constexpr size_t size() const {
+        return count;
+    }
+
+    constexpr size_t max_size() const {
+        return N;
+    }
+};
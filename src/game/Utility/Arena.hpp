@@ -0,0 +1,133 @@
+//
+//  Arena.hpp
+//  Project256
+//
+//  A bump allocator over a fixed region of the game memory block. Allocations
+//  are never freed one by one: the arena is rewound to a marker or reset as a
+//  whole, which is all that loading assets or a level needs. Sub arenas for
+//  shorter lifetimes are carved out of a longer lived one.
+//
+//  The arena lives inside the block it hands out, the block never moves, so the
+//  pointers in it stay valid for as long as the game memory does.
+//
+//  With ARENA_POISON, on by default in DEBUG builds, everything a rewind or reset
+//  frees is overwritten with ArenaPoison, so stale pointers read garbage that is
+//  easy to spot instead of data that still looks right.
+//
+
+#pragma once
+
+#ifndef ARENA_POISON
+#ifdef DEBUG
+#define ARENA_POISON 1
+#else
+#define ARENA_POISON 0
+#endif
+#endif
+
+#include "../defines.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+compiletime uint8_t ArenaPoison = 0xCD;
+
+struct Arena {
+    using Marker = size_t;
+
+    std::byte* base;
+    size_t capacity;
+    size_t used;
+    // the most that was ever in use at once, resets and rewinds do not lower it
+    size_t highWater;
+
+    void init(void* memory, size_t size) {
+        base = static_cast<std::byte*>(memory);
+        capacity = size;
+        used = 0;
+        highWater = 0;
+    }
+
+    bool isInitialized() const {
+        return base != nullptr;
+    }
+
+    size_t remaining() const {
+        return capacity - used;
+    }
+
+    // The free space, for data whose size is only known once it is written, like a file
+    // read into remaining() bytes. allocate(size, 1) right after keeps the first size bytes.
+    std::byte* top() const {
+        return base + used;
+    }
+
+    // size bytes at a multiple of alignment (a power of two), nullptr when they do not fit
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        const auto address = reinterpret_cast<uintptr_t>(base + used);
+        const size_t padding = (alignment - (address & (alignment - 1))) & (alignment - 1);
+        if (padding > remaining() || size > remaining() - padding)
+            return nullptr;
+        std::byte* result = base + used + padding;
+        used += padding + size;
+        highWater = used > highWater ? used : highWater;
+        return result;
+    }
+
+    // count uninitialized Ts, for types that need no constructor or destructor
+    template <typename T>
+    T* allocateArray(size_t count, size_t alignment = alignof(T)) {
+        static_assert(std::is_trivially_default_constructible_v<T> && std::is_trivially_destructible_v<T>);
+        if (count > SIZE_MAX / sizeof(T))
+            return nullptr;
+        return static_cast<T*>(allocate(count * sizeof(T), alignment < alignof(T) ? alignof(T) : alignment));
+    }
+
+    // like allocateArray, empty when the Ts do not fit
+    template <typename T>
+    std::span<T> allocateSpan(size_t count, size_t alignment = alignof(T)) {
+        T* data = allocateArray<T>(count, alignment);
+        return data ? std::span<T>(data, count) : std::span<T>();
+    }
+
+    Marker mark() const {
+        return used;
+    }
+
+    // frees everything allocated after the marker was taken
+    void rewind(Marker marker) {
+        if (marker >= used)
+            return;
+        if (ARENA_POISON) {
+            std::memset(base + marker, ArenaPoison, used - marker);
+        }
+        used = marker;
+    }
+
+    void reset() {
+        rewind(0);
+    }
+
+    // a sub arena of size bytes with a lifetime of its own, uninitialized when it does not fit
+    Arena carve(size_t size, size_t alignment = 64) {
+        Arena result{};
+        if (void* memory = allocate(size, alignment)) {
+            result.init(memory, size);
+        }
+        return result;
+    }
+};
+
+// rewinds the arena to where it was when the scope was entered
+struct ArenaScope {
+    Arena& arena;
+    Arena::Marker marker;
+
+    explicit ArenaScope(Arena& scopedArena) : arena(scopedArena), marker(scopedArena.mark()) {}
+    ~ArenaScope() { arena.rewind(marker); }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+};
@@ -0,0 +1,64 @@
+//
+//  CpuFeatures.hpp
+//  Project256
+//
+//  Runtime checks for the instruction set extensions the SIMD paths use. The
+//  project is built for the baseline of each architecture, so code that uses
+//  wider instructions is compiled per function with P256_TARGET and only called
+//  after asking here.
+//
+
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define P256_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC hands out every intrinsic without per function opt in
+#define P256_TARGET(features)
+#else
+#define P256_TARGET(features) __attribute__((target(features)))
+#endif
+#else
+#define P256_X86 0
+#define P256_TARGET(features)
+#endif
+
+namespace CpuFeatures {
+
+#if P256_X86
+
+#if defined(_MSC_VER) && !defined(__clang__)
+inline bool hasSsse3() {
+    int info[4];
+    __cpuid(info, 1);
+    return info[2] & (1 << 9);
+}
+
+inline bool hasAvx2() {
+    int info[4];
+    __cpuid(info, 1);
+    // the OS has to save the ymm registers too
+    const bool osSavesYmm = (info[2] & (1 << 27)) && (_xgetbv(0) & 0b110) == 0b110;
+    __cpuidex(info, 7, 0);
+    return osSavesYmm && (info[1] & (1 << 5));
+}
+#else
+inline bool hasSsse3() {
+    return __builtin_cpu_supports("ssse3");
+}
+
+inline bool hasAvx2() {
+    return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#else
+
+inline bool hasSsse3() { return false; }
+inline bool hasAvx2() { return false; }
+
+#endif
+
+}
@@ -0,0 +1,259 @@
+//
+//  InputRecording.hpp
+//  Project256
+//
+//  Compact recording and replay of the per-frame GameInput.
+//
+//  A recording is a small file header followed by one record per frame.
+//  Every record only stores the byte runs of GameInput that differ from the
+//  previous frame, so idle frames cost a handful of bytes (frame number and
+//  up time) and an hour at 60 fps stays in the low megabytes.
+//
+//  Record layout, all integers as LEB128 varints:
+//      runCount, { skip, length, bytes[length] } * runCount
+//  where `skip` is the number of unchanged bytes since the end of the last run.
+//
+
+#pragma once
+
+#include "../Project256.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace InputRecording {
+
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t inputSize;
+};
+
+compiletime uint32_t Version = 1;
+compiletime FileHeader Header { {'P', '2', '5', '6'}, Version, sizeof(GameInput) };
+
+// Unchanged gaps shorter than this are folded into the surrounding run,
+// since starting a new run costs at least two bytes of varints.
+compiletime size_t MinimumGap = 3;
+// Upper bound for one encoded frame: every byte changed plus run headers.
+compiletime size_t MaxRecordSize = sizeof(GameInput) + 16;
+
+constexpr size_t writeVarint(uint8_t* out, uint64_t value) {
+    size_t written = 0;
+    do {
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out[written++] = byte | (value ? 0x80 : 0);
+    } while (value);
+    return written;
+}
+
+constexpr size_t readVarint(const uint8_t* in, size_t size, uint64_t& value) {
+    value = 0;
+    for (size_t i = 0; i < size && i < 10; ++i) {
+        value |= static_cast<uint64_t>(in[i] & 0x7F) << (7 * i);
+        if (!(in[i] & 0x80))
+            return i + 1;
+    }
+    return 0;
+}
+
+// Writes the delta from `previous` to `current` into `out`, which must hold
+// MaxRecordSize bytes. Returns the number of bytes written.
+inline size_t encodeDelta(const GameInput& previous, const GameInput& current, uint8_t* out) {
+    const uint8_t* before = reinterpret_cast<const uint8_t*>(&previous);
+    const uint8_t* after = reinterpret_cast<const uint8_t*>(&current);
+    constexpr size_t size = sizeof(GameInput);
+
+    // the run count is only known at the end, so the runs are collected here and copied in after it
+    uint8_t runs[MaxRecordSize];
+    size_t runsSize = 0;
+    uint64_t runCount = 0;
+    size_t position = 0;
+    size_t lastRunEnd = 0;
+    while (position < size) {
+        if (before[position] == after[position]) {
+            ++position;
+            continue;
+        }
+        size_t runStart = position;
+        size_t runEnd = position + 1;
+        size_t gap = 0;
+        for (size_t i = runEnd; i < size && gap < MinimumGap; ++i) {
+            if (before[i] != after[i]) {
+                runEnd = i + 1;
+                gap = 0;
+            } else {
+                ++gap;
+            }
+        }
+        runsSize += writeVarint(runs + runsSize, runStart - lastRunEnd);
+        runsSize += writeVarint(runs + runsSize, runEnd - runStart);
+        std::memcpy(runs + runsSize, after + runStart, runEnd - runStart);
+        runsSize += runEnd - runStart;
+        ++runCount;
+        lastRunEnd = position = runEnd;
+    }
+    size_t written = writeVarint(out, runCount);
+    std::memcpy(out + written, runs, runsSize);
+    return written + runsSize;
+}
+
+// Applies one encoded record onto `input`. Returns the number of bytes
+// consumed, or 0 if the record is malformed.
+inline size_t decodeDelta(const uint8_t* in, size_t size, GameInput& input) {
+    uint8_t* target = reinterpret_cast<uint8_t*>(&input);
+    uint64_t runCount = 0;
+    size_t consumed = readVarint(in, size, runCount);
+    if (!consumed)
+        return 0;
+    size_t position = 0;
+    for (uint64_t run = 0; run < runCount; ++run) {
+        uint64_t skip = 0, length = 0;
+        size_t read = readVarint(in + consumed, size - consumed, skip);
+        if (!read) return 0;
+        consumed += read;
+        read = readVarint(in + consumed, size - consumed, length);
+        if (!read) return 0;
+        consumed += read;
+        position += skip;
+        if (position + length > sizeof(GameInput) || consumed + length > size)
+            return 0;
+        std::memcpy(target + position, in + consumed, length);
+        consumed += length;
+        position += length;
+    }
+    return consumed;
+}
+
+
+struct Recorder {
+    FILE* file{};
+    GameInput previous{};
+    uint64_t frameCount{};
+    uint64_t bytesWritten{};
+    // A write came up short, or the last buffered bytes could not be written on close. The file
+    // then ends early and would replay as a shorter session; nothing more is recorded.
+    bool failed{};
+    int error{};
+
+    bool open(const char* filename) {
+        file = std::fopen(filename, "wb");
+        failed = false;
+        error = 0;
+        if (!file) {
+            fail();
+            return false;
+        }
+        previous = GameInput{};
+        frameCount = 0;
+        bytesWritten = std::fwrite(&Header, 1, sizeof(Header), file);
+        if (bytesWritten != sizeof(Header)) {
+            fail();
+            return false;
+        }
+        return true;
+    }
+
+    bool isOpen() const {
+        return file != nullptr;
+    }
+
+    // false once the recording has failed
+    bool record(const GameInput& input) {
+        if (failed)
+            return false;
+        uint8_t buffer[MaxRecordSize];
+        size_t size = encodeDelta(previous, input, buffer);
+        const size_t written = std::fwrite(buffer, 1, size, file);
+        bytesWritten += written;
+        if (written != size) {
+            fail();
+            return false;
+        }
+        previous = input;
+        ++frameCount;
+        return true;
+    }
+
+    // false when the recording failed, including while flushing what was still buffered
+    bool close() {
+        if (file) {
+            if (std::fclose(file) != 0 && !failed) {
+                fail();
+            }
+            file = nullptr;
+        }
+        return !failed;
+    }
+
+private:
+    void fail() {
+        failed = true;
+        error = errno;
+    }
+};
+
+
+struct Player {
+    FILE* file{};
+    GameInput current{};
+    uint64_t frameCount{};
+    // read window, records never exceed MaxRecordSize
+    uint8_t buffer[MaxRecordSize * 2];
+    size_t bufferBegin{};
+    size_t bufferEnd{};
+
+    bool open(const char* filename) {
+        file = std::fopen(filename, "rb");
+        if (!file)
+            return false;
+        FileHeader header{};
+        if (std::fread(&header, 1, sizeof(header), file) != sizeof(header)
+            || std::memcmp(header.magic, Header.magic, sizeof(header.magic)) != 0
+            || header.version != Header.version
+            || header.inputSize != Header.inputSize) {
+            close();
+            return false;
+        }
+        current = GameInput{};
+        frameCount = 0;
+        bufferBegin = bufferEnd = 0;
+        return true;
+    }
+
+    bool isOpen() const {
+        return file != nullptr;
+    }
+
+    // Overwrites `input` with the next recorded frame, false at the end of the recording.
+    bool next(GameInput& input) {
+        if (!file)
+            return false;
+        if (bufferEnd - bufferBegin < MaxRecordSize) {
+            std::memmove(buffer, buffer + bufferBegin, bufferEnd - bufferBegin);
+            bufferEnd -= bufferBegin;
+            bufferBegin = 0;
+            bufferEnd += std::fread(buffer + bufferEnd, 1, sizeof(buffer) - bufferEnd, file);
+        }
+        if (bufferBegin == bufferEnd)
+            return false;
+        size_t consumed = decodeDelta(buffer + bufferBegin, bufferEnd - bufferBegin, current);
+        if (!consumed)
+            return false;
+        bufferBegin += consumed;
+        ++frameCount;
+        input = current;
+        return true;
+    }
+
+    void close() {
+        if (file) {
+            std::fclose(file);
+            file = nullptr;
+        }
+    }
+};
+
+}
@@ -0,0 +1,306 @@
+//
+//  Rewind.hpp
+//  Project256
+//
+//  A history of the game memory block to step back through, one snapshot per
+//  frame. Each snapshot stores the XOR of the block against the one before,
+//  as runs of changed 8 byte words:
+//
+//      { varint skipWords, varint lengthWords, lengthWords * 8 bytes of XOR } * n
+//
+//  Applying a delta turns either of its two frames into the other, so rewinding
+//  from the newest frame walks the deltas backwards. Every keyframeInterval
+//  frames the whole block is stored as well, as a delta against zeros, and a
+//  long rewind starts from the closest keyframe instead when that is less work.
+//  When the history hits its memory cap the oldest frames go first.
+//
+//  Lives next to the memory block, not in it: restoring the block must not
+//  restore the history too.
+//
+
+#pragma once
+
+#include "InputRecording.hpp"
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+namespace Rewind {
+
+compiletime size_t WordSize = 8;
+// Unchanged stretches shorter than this are folded into the run around them. Then
+// every run but the first skips more bytes than its two varints take, and a delta
+// is never larger than the block plus MaxRunHeader.
+compiletime size_t MinimumGapWords = 3;
+compiletime size_t MaxRunHeader = 20;
+// unchanged memory is skipped this many bytes at a time
+compiletime size_t CompareChunkSize = 256;
+
+constexpr size_t deltaSizeBound(size_t size) {
+    return size + MaxRunHeader;
+}
+
+// Writes the XOR of before and after, size bytes each, to out, which holds deltaSizeBound(size)
+// bytes. A null before stands for zeros. Returns the number of bytes written.
+inline size_t encodeXor(const uint8_t* before, const uint8_t* after, size_t size, uint8_t* out) {
+    constexpr size_t ChunkWords = CompareChunkSize / WordSize;
+    localpersist const uint8_t zeros[CompareChunkSize]{};
+    auto word = [](const uint8_t* memory, size_t index) {
+        uint64_t value = 0;
+        if (memory) {
+            std::memcpy(&value, memory + index * WordSize, WordSize);
+        }
+        return value;
+    };
+
+    const size_t words = size / WordSize;
+    size_t written = 0;
+    size_t lastRunEnd = 0;
+    size_t position = 0;
+    while (position < words) {
+        if (position % ChunkWords == 0 && position + ChunkWords <= words
+            && std::memcmp(before ? before + position * WordSize : zeros, after + position * WordSize, CompareChunkSize) == 0) {
+            position += ChunkWords;
+            continue;
+        }
+        if (word(before, position) == word(after, position)) {
+            ++position;
+            continue;
+        }
+        const size_t runStart = position;
+        size_t runEnd = position + 1;
+        size_t gap = 0;
+        for (size_t i = runEnd; i < words && gap < MinimumGapWords; ++i) {
+            if (word(before, i) != word(after, i)) {
+                runEnd = i + 1;
+                gap = 0;
+            } else {
+                ++gap;
+            }
+        }
+        written += InputRecording::writeVarint(out + written, runStart - lastRunEnd);
+        written += InputRecording::writeVarint(out + written, runEnd - runStart);
+        for (size_t i = runStart; i < runEnd; ++i) {
+            const uint64_t difference = word(before, i) ^ word(after, i);
+            std::memcpy(out + written, &difference, WordSize);
+            written += WordSize;
+        }
+        lastRunEnd = position = runEnd;
+    }
+    return written;
+}
+
+// XORs an encoded delta onto target, false if it is malformed or does not fit in size bytes
+inline bool applyXor(const uint8_t* delta, size_t deltaSize, uint8_t* target, size_t size) {
+    size_t consumed = 0;
+    size_t position = 0;
+    while (consumed < deltaSize) {
+        uint64_t skip = 0, length = 0;
+        size_t read = InputRecording::readVarint(delta + consumed, deltaSize - consumed, skip);
+        if (!read) return false;
+        consumed += read;
+        read = InputRecording::readVarint(delta + consumed, deltaSize - consumed, length);
+        if (!read) return false;
+        consumed += read;
+        position += skip;
+        if ((position + length) * WordSize > size || consumed + length * WordSize > deltaSize)
+            return false;
+        for (uint64_t i = 0; i < length; ++i, ++position, consumed += WordSize) {
+            uint64_t value, difference;
+            std::memcpy(&value, target + position * WordSize, WordSize);
+            std::memcpy(&difference, delta + consumed, WordSize);
+            value ^= difference;
+            std::memcpy(target + position * WordSize, &value, WordSize);
+        }
+    }
+    return true;
+}
+
+
+struct Buffer {
+    struct Record {
+        size_t offset;
+        size_t size;
+    };
+
+    struct Frame {
+        // against the frame before, the oldest frame's is never needed
+        Record delta;
+        // against zeros, size 0 for frames without a keyframe
+        Record keyframe;
+    };
+
+    size_t blockSize{};
+    size_t keyframeInterval{};
+    // how much of the start of the block is tracked, never shrinks
+    size_t extent{};
+    // the block as of the newest snapshot
+    std::unique_ptr<uint8_t[]> shadow;
+
+    // encoded records in snapshot order, wrapping around
+    std::unique_ptr<uint8_t[]> storage;
+    size_t storageSize{};
+    size_t head{};
+    size_t tail{};
+
+    std::unique_ptr<Frame[]> frames;
+    size_t maxFrames{};
+    size_t firstFrame{};
+    size_t frameCount{};
+    uint64_t snapshotCount{};
+    size_t lastSnapshotSize{};
+
+    // Everything, the shadow copy of the block included, stays within memoryCap bytes.
+    // False when that does not leave room for at least one full frame.
+    bool init(size_t newBlockSize, size_t memoryCap, size_t newKeyframeInterval = 60, size_t newMaxFrames = 3600) {
+        const size_t fixedSize = newBlockSize + newMaxFrames * sizeof(Frame);
+        // three frames' worth, so the newest delta never has to go to make room for its keyframe
+        if (newBlockSize % WordSize != 0 || newMaxFrames == 0 || memoryCap < fixedSize + 3 * deltaSizeBound(newBlockSize))
+            return false;
+        blockSize = newBlockSize;
+        keyframeInterval = newKeyframeInterval;
+        extent = 0;
+        shadow = std::make_unique<uint8_t[]>(blockSize);
+        storageSize = memoryCap - fixedSize;
+        storage = std::make_unique<uint8_t[]>(storageSize);
+        maxFrames = newMaxFrames;
+        frames = std::make_unique<Frame[]>(maxFrames);
+        clear();
+        return true;
+    }
+
+    bool isInitialized() const {
+        return shadow != nullptr;
+    }
+
+    void clear() {
+        head = tail = 0;
+        firstFrame = frameCount = 0;
+        snapshotCount = 0;
+        if (shadow) {
+            std::memset(shadow.get(), 0, blockSize);
+        }
+        extent = 0;
+    }
+
+    // number of frames back rewind() can go
+    size_t depth() const {
+        return frameCount ? frameCount - 1 : 0;
+    }
+
+    size_t bytesInUse() const {
+        if (frameCount == 0)
+            return 0;
+        return head > tail ? head - tail : storageSize - tail + head;
+    }
+
+    // Records the first usedSize bytes of the block as the newest frame. Costs a compare
+    // of those bytes against the shadow copy plus work in proportion to what changed.
+    void snapshot(const void* block, size_t usedSize) {
+        const size_t used = usedSize < blockSize ? usedSize : blockSize;
+        const size_t rounded = (used + WordSize - 1) / WordSize * WordSize;
+        extent = rounded > extent ? rounded : extent;
+        const auto* current = static_cast<const uint8_t*>(block);
+
+        if (frameCount == maxFrames) {
+            dropOldest();
+        }
+        Frame frame{};
+        uint8_t* out = reserve(deltaSizeBound(extent));
+        frame.delta = { static_cast<size_t>(out - storage.get()), encodeXor(shadow.get(), current, extent, out) };
+        head = frame.delta.offset + frame.delta.size;
+        applyXor(out, frame.delta.size, shadow.get(), extent);
+        lastSnapshotSize = frame.delta.size;
+
+        at(frameCount++) = frame;
+
+        if (keyframeInterval && snapshotCount % keyframeInterval == 0) {
+            out = reserve(deltaSizeBound(extent));
+            Record& keyframe = at(frameCount - 1).keyframe;
+            keyframe = { static_cast<size_t>(out - storage.get()), encodeXor(nullptr, shadow.get(), extent, out) };
+            head = keyframe.offset + keyframe.size;
+            lastSnapshotSize += keyframe.size;
+        }
+        ++snapshotCount;
+    }
+
+    // Puts the block back the way it was framesBack snapshots ago and forgets the newer ones,
+    // false when the history does not go back that far. The block is copied over byte by byte,
+    // atomics and the state of other threads included, so nothing else may touch it meanwhile.
+    bool rewind(size_t framesBack, void* block) {
+        if (frameCount == 0 || framesBack > depth())
+            return false;
+        const size_t target = frameCount - 1 - framesBack;
+
+        size_t backwardCost = 0;
+        for (size_t i = target + 1; i < frameCount; ++i) {
+            backwardCost += at(i).delta.size;
+        }
+        size_t keyframe = target + 1;
+        size_t forwardCost = 0;
+        for (size_t i = target + 1; i-- > 0;) {
+            if (at(i).keyframe.size) {
+                keyframe = i;
+                forwardCost += extent + at(i).keyframe.size;
+                break;
+            }
+            forwardCost += at(i).delta.size;
+        }
+
+        if (keyframe <= target && forwardCost < backwardCost) {
+            std::memset(shadow.get(), 0, extent);
+            applyXor(storage.get() + at(keyframe).keyframe.offset, at(keyframe).keyframe.size, shadow.get(), extent);
+            for (size_t i = keyframe + 1; i <= target; ++i) {
+                applyXor(storage.get() + at(i).delta.offset, at(i).delta.size, shadow.get(), extent);
+            }
+        } else {
+            for (size_t i = frameCount - 1; i > target; --i) {
+                applyXor(storage.get() + at(i).delta.offset, at(i).delta.size, shadow.get(), extent);
+            }
+        }
+
+        frameCount = target + 1;
+        const Frame& newest = at(target);
+        head = newest.keyframe.size ? newest.keyframe.offset + newest.keyframe.size : newest.delta.offset + newest.delta.size;
+        snapshotCount -= framesBack;
+        std::memcpy(block, shadow.get(), extent);
+        return true;
+    }
+
+private:
+    Frame& at(size_t index) {
+        return frames[(firstFrame + index) % maxFrames];
+    }
+
+    void dropOldest() {
+        firstFrame = (firstFrame + 1) % maxFrames;
+        --frameCount;
+        tail = frameCount ? at(0).delta.offset : 0;
+        if (frameCount == 0) {
+            head = 0;
+        }
+    }
+
+    // room for size contiguous bytes at or after head, dropping the oldest frames for it
+    uint8_t* reserve(size_t size) {
+        for (;;) {
+            if (frameCount == 0) {
+                head = tail = 0;
+                return storage.get();
+            }
+            if (head > tail) {
+                if (storageSize - head >= size)
+                    return storage.get() + head;
+                if (tail >= size) {
+                    head = 0;
+                    return storage.get();
+                }
+            } else if (head < tail && tail - head >= size) {
+                return storage.get() + head;
+            }
+            dropOldest();
+        }
+    }
+};
+
+}
@@ -0,0 +1,94 @@
+//
+//  TripleBuffer.hpp
+//  Project256
+//
+//  Wait-free handoff of whole values from one producer thread to one consumer
+//  thread. The producer always owns a back buffer to write into, the consumer
+//  always owns the buffer it is reading, and the third one sits in the middle
+//  holding the newest published value. Neither side ever blocks or retries.
+//
+//  Lives inside the game memory block: a zeroed TripleBuffer reads as "nothing
+//  published yet", and the producer calls reset() once before its first publish.
+//
+
+#pragma once
+
+#include "../defines.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+template <typename T>
+struct TripleBuffer {
+    compiletime uint8_t IndexMask = 0b0011;
+    compiletime uint8_t FreshFlag = 0b0100;
+    compiletime uint8_t ValidFlag = 0b1000;
+
+    std::array<T, 3> buffers;
+    // index of the middle buffer, plus flags
+    std::atomic<uint8_t> shared;
+    // owned by the producer
+    uint8_t writeIndex;
+    // owned by the consumer, initialised by reset() before the first publish makes it visible
+    uint8_t readIndex;
+
+    static_assert(std::atomic<uint8_t>::is_always_lock_free);
+
+    // producer side
+
+    void reset() {
+        writeIndex = 0;
+        readIndex = 2;
+        shared.store(1, std::memory_order_release);
+    }
+
+    T& back() {
+        return buffers[writeIndex];
+    }
+
+    // hands the back buffer to the consumer and takes the middle one in exchange
+    void publish() {
+        const uint8_t previous = shared.exchange(writeIndex | FreshFlag | ValidFlag, std::memory_order_acq_rel);
+        writeIndex = previous & IndexMask;
+    }
+
+    // like publish(), but starts the new back buffer as a copy of the published one,
+    // for producers that update their frame incrementally instead of redrawing it
+    void publishAndCarryOver() {
+        const uint8_t published = writeIndex;
+        publish();
+        // the published buffer is only ever read from now on, so copying out of it is safe
+        buffers[writeIndex] = buffers[published];
+    }
+
+    // consumer side
+
+    bool hasPublished() const {
+        return shared.load(std::memory_order_acquire) & ValidFlag;
+    }
+
+    // the newest published value, nullptr until the first publish
+    const T* latest() {
+        const uint8_t state = shared.load(std::memory_order_acquire);
+        if (!(state & ValidFlag))
+            return nullptr;
+        if (state & FreshFlag) {
+            swapIn();
+        }
+        return &buffers[readIndex];
+    }
+
+    // the newest published value if it was not returned before, nullptr otherwise
+    const T* fresh() {
+        const uint8_t state = shared.load(std::memory_order_acquire);
+        if (!(state & FreshFlag))
+            return nullptr;
+        swapIn();
+        return &buffers[readIndex];
+    }
+
+    void swapIn() {
+        const uint8_t previous = shared.exchange(readIndex | ValidFlag, std::memory_order_acq_rel);
+        readIndex = previous & IndexMask;
+    }
+};
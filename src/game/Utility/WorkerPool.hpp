@@ -0,0 +1,137 @@
+//
+//  WorkerPool.hpp
+//  Project256
+//
+//  A handful of threads for fork/join work on the calling thread's behalf. The
+//  caller hands out a number of bands, takes a share of them itself and returns
+//  once every band is done. Without worker threads everything simply runs on the
+//  caller, so code can use the pool unconditionally.
+//
+
+#pragma once
+
+#include "../defines.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+
+struct WorkerPool {
+    // worker threads at most, the caller comes on top of them
+    compiletime size_t MaxThreads = 16;
+
+    std::array<std::thread, MaxThreads> threads;
+    // worker threads, not counting the caller
+    size_t threadCount = 0;
+
+    // bumped once per job, workers sleep on it
+    std::atomic<uint32_t> generation{};
+    std::atomic<bool> shouldQuit{};
+    // workers that still have to check in for the current job
+    std::atomic<size_t> remaining{};
+
+    // the current job, written before generation is bumped
+    void (*invoke)(void*, size_t) = nullptr;
+    void* context = nullptr;
+    size_t bandCount = 0;
+    std::atomic<size_t> nextBand{};
+
+    WorkerPool() = default;
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() {
+        stop();
+    }
+
+    // total number of threads taking part in a job, including the caller
+    size_t concurrency() const {
+        return threadCount + 1;
+    }
+
+    // totalThreads counts the caller, so 0 and 1 start no worker and anything above MaxThreads + 1 is clamped
+    void start(size_t totalThreads) {
+        stop();
+        threadCount = std::min(std::max<size_t>(totalThreads, 1), MaxThreads + 1) - 1;
+        shouldQuit.store(false, std::memory_order_relaxed);
+        const uint32_t seen = generation.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < threadCount; ++i) {
+            threads[i] = std::thread([this, seen] { workerLoop(seen); });
+        }
+    }
+
+    void stop() {
+        if (threadCount == 0)
+            return;
+        shouldQuit.store(true, std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_release);
+        generation.notify_all();
+        for (size_t i = 0; i < threadCount; ++i) {
+            threads[i].join();
+        }
+        threadCount = 0;
+    }
+
+    // calls f(band) for every band in [0, count) and returns when all of them are done
+    template <typename F>
+    void run(size_t count, F&& f) {
+        if (threadCount == 0 || count <= 1) {
+            for (size_t band = 0; band < count; ++band) {
+                f(band);
+            }
+            return;
+        }
+        invoke = [](void* c, size_t band) { (*static_cast<std::remove_reference_t<F>*>(c))(band); };
+        context = &f;
+        bandCount = count;
+        nextBand.store(0, std::memory_order_relaxed);
+        remaining.store(threadCount, std::memory_order_relaxed);
+        generation.fetch_add(1, std::memory_order_release);
+        generation.notify_all();
+
+        work();
+        // every worker checks in, even the ones that found no band left, so none
+        // of them can still be looking at this job when the next one is set up
+        for (size_t r; (r = remaining.load(std::memory_order_acquire)) != 0;) {
+            remaining.wait(r, std::memory_order_acquire);
+        }
+    }
+
+    // splits count rows starting at first into bands of at least minRows, one per thread at most,
+    // and calls f(firstRow, rowCount) for each. Returns how many bands there were.
+    template <typename F>
+    size_t forEachBand(size_t first, size_t count, size_t minRows, F&& f) {
+        size_t bands = minRows ? count / minRows : count;
+        bands = bands < concurrency() ? bands : concurrency();
+        bands = bands ? bands : 1;
+        run(bands, [&](size_t band) {
+            const size_t begin = first + count * band / bands;
+            const size_t end = first + count * (band + 1) / bands;
+            f(begin, end - begin);
+        });
+        return bands;
+    }
+
+private:
+    void work() {
+        for (size_t band; (band = nextBand.fetch_add(1, std::memory_order_relaxed)) < bandCount;) {
+            invoke(context, band);
+        }
+    }
+
+    void workerLoop(uint32_t seen) {
+        for (;;) {
+            generation.wait(seen, std::memory_order_acquire);
+            seen = generation.load(std::memory_order_acquire);
+            if (shouldQuit.load(std::memory_order_relaxed))
+                return;
+            work();
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                remaining.notify_one();
+            }
+        }
+    }
+};
@@ -8,6 +8,11 @@
 #ifndef defines_h
 #define defines_h
 
+/// glibc's struct timex has a member named `constant`, pull it in before the macros below
+#ifdef __linux__
+#include <time.h>
+#endif
+
 /// clarifying defines for static
 #define compiletime static constexpr
 #define constant static const
@@ -0,0 +1,156 @@
+#include "AudioRenderer.h"
+#include "GameState.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <time.h>
+
+internalfunc int64_t nowNanoseconds() {
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<int64_t>(now.tv_sec) * 1'000'000'000 + now.tv_nsec;
+}
+
+internalfunc void putLE(uint8_t* destination, uint32_t value, int byteCount) {
+    for (int i = 0; i < byteCount; ++i) {
+        destination[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+bool WavWriter::open(const char* filename, uint32_t sampleRate, uint16_t channels, uint16_t bitsPerSample)
+{
+    file = std::fopen(filename, "wb");
+    failed = false;
+    error = 0;
+    if (!file) {
+        fail();
+        return false;
+    }
+    dataBytes = 0;
+
+    const uint16_t blockAlign = channels * bitsPerSample / 8;
+    uint8_t header[44]{};
+    std::memcpy(header, "RIFF", 4);
+    putLE(header + 4, 36, 4);
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    putLE(header + 16, 16, 4);
+    putLE(header + 20, 1, 2); // PCM
+    putLE(header + 22, channels, 2);
+    putLE(header + 24, sampleRate, 4);
+    putLE(header + 28, sampleRate * blockAlign, 4);
+    putLE(header + 32, blockAlign, 2);
+    putLE(header + 34, bitsPerSample, 2);
+    std::memcpy(header + 36, "data", 4);
+    putLE(header + 40, 0, 4);
+    if (std::fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+        fail();
+        return false;
+    }
+    return true;
+}
+
+bool WavWriter::write(const void* data, uint32_t size)
+{
+    if (failed)
+        return false;
+    const size_t written = std::fwrite(data, 1, size, file);
+    dataBytes += static_cast<uint32_t>(written);
+    if (written != size) {
+        fail();
+        return false;
+    }
+    return true;
+}
+
+bool WavWriter::close()
+{
+    if (!file)
+        return !failed;
+    if (!failed) {
+        uint8_t size[4];
+        putLE(size, 36 + dataBytes, 4);
+        if (std::fseek(file, 4, SEEK_SET) != 0 || std::fwrite(size, 1, 4, file) != 4) {
+            fail();
+        }
+        putLE(size, dataBytes, 4);
+        if (!failed && (std::fseek(file, 40, SEEK_SET) != 0 || std::fwrite(size, 1, 4, file) != 4)) {
+            fail();
+        }
+    }
+    if (std::fclose(file) != 0 && !failed) {
+        fail();
+    }
+    file = nullptr;
+    return !failed;
+}
+
+void WavWriter::fail()
+{
+    failed = true;
+    error = errno;
+}
+
+
+int AudioRenderer::render(GameState& gameState, const char* filename, int bufferCount)
+{
+    const auto& descriptor = gameState.audioBufferDescriptor;
+    const uint32_t bufferBytes = descriptor.framesPerBuffer * descriptor.channelsPerFrame * AudioBitsPerSample / 8;
+    if (filename && !wav.open(filename, static_cast<uint32_t>(descriptor.sampleRate), descriptor.channelsPerFrame, AudioBitsPerSample)) {
+        std::fprintf(stderr, "Could not open %s for writing: %s\n", filename, std::strerror(wav.error));
+        wav.close();
+        return -1;
+    }
+
+    // the time the platform has to produce one buffer before it is due
+    const double deadline_ns = descriptor.framesPerBuffer * 1e9 / descriptor.sampleRate;
+    int64_t total_ns = 0;
+    int64_t fastest_ns = INT64_MAX;
+    int64_t slowest_ns = 0;
+    int overrunCount = 0;
+
+    if (printEachBuffer) {
+        std::printf("%-7s %12s %14s %10s\n", "buffer", "ns/sample", "frames/s", "deadline");
+    }
+    for (int buffer = 0; buffer < bufferCount; ++buffer) {
+        const int64_t start = nowNanoseconds();
+        gameState.writeAudio();
+        const int64_t elapsed_ns = std::max<int64_t>(nowNanoseconds() - start, 1);
+
+        if (filename && !wav.write(gameState.audioBuffer, bufferBytes)) {
+            break;
+        }
+
+        total_ns += elapsed_ns;
+        fastest_ns = std::min(fastest_ns, elapsed_ns);
+        slowest_ns = std::max(slowest_ns, elapsed_ns);
+        overrunCount += elapsed_ns > deadline_ns ? 1 : 0;
+
+        if (printEachBuffer) {
+            std::printf("%-7d %12.1f %14.0f %9.2f%%\n", buffer,
+                        double(elapsed_ns) / descriptor.framesPerBuffer,
+                        descriptor.framesPerBuffer * 1e9 / elapsed_ns,
+                        100.0 * elapsed_ns / deadline_ns);
+        }
+    }
+    if (filename && !wav.close()) {
+        std::fprintf(stderr, "Writing %s failed, the audio is cut short: %s\n", filename, std::strerror(wav.error));
+        return -1;
+    }
+
+    if (bufferCount > 0) {
+        const double frames = double(bufferCount) * descriptor.framesPerBuffer;
+        std::printf("rendered %d buffers (%.2f s of audio) in %.3f s, %.1fx realtime\n",
+                    bufferCount, frames / descriptor.sampleRate, total_ns / 1e9,
+                    frames / descriptor.sampleRate / (total_ns / 1e9));
+        std::printf("ns/sample min %.1f mean %.1f max %.1f, %.0f frames/s, worst buffer %.2f%% of its %.2f ms deadline, %d overruns\n",
+                    double(fastest_ns) / descriptor.framesPerBuffer,
+                    total_ns / frames,
+                    double(slowest_ns) / descriptor.framesPerBuffer,
+                    frames * 1e9 / total_ns,
+                    100.0 * slowest_ns / deadline_ns,
+                    deadline_ns / 1e6,
+                    overrunCount);
+    }
+    return overrunCount;
+}
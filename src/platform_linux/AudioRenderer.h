@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include "../game/Project256.h"
+
+struct GameState;
+
+// 16 bit PCM WAV file, the data size is patched in on close
+struct WavWriter {
+    FILE* file{};
+    uint32_t dataBytes{};
+    // A write or the size patch came up short, the file is cut off or has a wrong header.
+    // Nothing more is written once this is set.
+    bool failed{};
+    int error{};
+
+    bool open(const char* filename, uint32_t sampleRate, uint16_t channels, uint16_t bitsPerSample);
+    // false once writing has failed
+    bool write(const void* data, uint32_t size);
+    // false when writing failed, including patching the sizes and flushing on close
+    bool close();
+
+private:
+    void fail();
+};
+
+// Calls writeAudioBuffer back to back, as fast as it will go, and reports
+// the throughput of each buffer against its realtime deadline.
+struct AudioRenderer {
+    WavWriter wav{};
+    bool printEachBuffer = true;
+
+    // returns the number of buffers that took longer than their playback time,
+    // or -1 when the WAV file could not be written
+    int render(GameState& gameState, const char* filename, int bufferCount);
+};
@@ -0,0 +1,222 @@
+#include "GameModule.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct GameFunctions {
+    decltype(&::clipSpaceDrawBufferScale) clipSpaceDrawBufferScale;
+    decltype(&::cleanInput) cleanInput;
+    decltype(&::doGameThings) doGameThings;
+    decltype(&::writeDrawBuffer) writeDrawBuffer;
+    decltype(&::writeDrawBufferRows) writeDrawBufferRows;
+    decltype(&::setDrawBufferThreadCount) setDrawBufferThreadCount;
+    decltype(&::invalidateDrawBuffer) invalidateDrawBuffer;
+    decltype(&::printMemoryLayout) printMemoryLayout;
+    decltype(&::gameMemoryInUse) gameMemoryInUse;
+    decltype(&::gameMemoryLayoutHash) gameMemoryLayoutHash;
+    decltype(&::printProfilingZones) printProfilingZones;
+    decltype(&::clearProfilingZones) clearProfilingZones;
+    decltype(&::writeAudioBuffer) writeAudioBuffer;
+    decltype(&::lastAudioBufferLockWait) lastAudioBufferLockWait;
+};
+
+globalvar GameFunctions game{};
+// the loaded version starts its own draw workers, a new one gets as many
+globalvar unsigned drawThreadCount = 1;
+
+// dlopen hands out the same handle for a path it has open, so every version is loaded from a copy of its own
+internalfunc void* openCopy(const char* path, char* error, size_t errorSize) {
+    const int source = open(path, O_RDONLY);
+    if (source < 0) {
+        std::snprintf(error, errorSize, "could not open %s: %s", path, std::strerror(errno));
+        return nullptr;
+    }
+    char copyPath[] = "/tmp/Project256-XXXXXX.so";
+    const int copy = mkstemps(copyPath, 3);
+    if (copy < 0) {
+        std::snprintf(error, errorSize, "could not create a copy of %s: %s", path, std::strerror(errno));
+        close(source);
+        return nullptr;
+    }
+    char buffer[64 * 1024];
+    bool copied = true;
+    for (ssize_t size; (size = read(source, buffer, sizeof(buffer))) != 0;) {
+        if (size < 0 || write(copy, buffer, static_cast<size_t>(size)) != size) {
+            copied = false;
+            break;
+        }
+    }
+    close(source);
+    close(copy);
+
+    void* handle = copied ? dlopen(copyPath, RTLD_NOW | RTLD_LOCAL) : nullptr;
+    if (!handle) {
+        std::snprintf(error, errorSize, "could not load %s: %s", path, copied ? dlerror() : "copy failed");
+    }
+    // the mapping stays when the file goes
+    unlink(copyPath);
+    return handle;
+}
+
+internalfunc bool resolve(void* handle, GameFunctions& functions, char* error, size_t errorSize) {
+    bool found = true;
+    auto symbol = [&](auto& function, const char* name) {
+        function = reinterpret_cast<std::remove_reference_t<decltype(function)>>(dlsym(handle, name));
+        if (!function && found) {
+            std::snprintf(error, errorSize, "missing %s", name);
+            found = false;
+        }
+    };
+    symbol(functions.clipSpaceDrawBufferScale, "clipSpaceDrawBufferScale");
+    symbol(functions.cleanInput, "cleanInput");
+    symbol(functions.doGameThings, "doGameThings");
+    symbol(functions.writeDrawBuffer, "writeDrawBuffer");
+    symbol(functions.writeDrawBufferRows, "writeDrawBufferRows");
+    symbol(functions.setDrawBufferThreadCount, "setDrawBufferThreadCount");
+    symbol(functions.invalidateDrawBuffer, "invalidateDrawBuffer");
+    symbol(functions.printMemoryLayout, "printMemoryLayout");
+    symbol(functions.gameMemoryInUse, "gameMemoryInUse");
+    symbol(functions.gameMemoryLayoutHash, "gameMemoryLayoutHash");
+    symbol(functions.printProfilingZones, "printProfilingZones");
+    symbol(functions.clearProfilingZones, "clearProfilingZones");
+    symbol(functions.writeAudioBuffer, "writeAudioBuffer");
+    symbol(functions.lastAudioBufferLockWait, "lastAudioBufferLockWait");
+    return found;
+}
+
+internalfunc bool modificationTime(const char* path, timespec& time) {
+    struct stat status{};
+    if (stat(path, &status) != 0)
+        return false;
+    time = status.st_mtim;
+    return true;
+}
+
+bool GameModule::load(const char* modulePath, void* memory)
+{
+    path = modulePath;
+    modificationTime(path, modified);
+    void* newHandle = openCopy(path, error, sizeof(error));
+    GameFunctions functions{};
+    if (!newHandle || !resolve(newHandle, functions, error, sizeof(error)))
+        return false;
+    handle = newHandle;
+    game = functions;
+    layoutHash = game.gameMemoryLayoutHash(memory);
+    return true;
+}
+
+GameModule::Reload GameModule::reloadIfChanged(void* memory)
+{
+    timespec time{};
+    if (!modificationTime(path, time) || (time.tv_sec == modified.tv_sec && time.tv_nsec == modified.tv_nsec))
+        return Reload::Unchanged;
+    // a version that fails is not tried again until the file changes once more
+    modified = time;
+
+    void* newHandle = openCopy(path, error, sizeof(error));
+    GameFunctions functions{};
+    if (!newHandle || !resolve(newHandle, functions, error, sizeof(error))) {
+        ++rejectCount;
+        return Reload::Rejected;
+    }
+    const uint64_t newLayoutHash = functions.gameMemoryLayoutHash(memory);
+    if (newLayoutHash != layoutHash) {
+        std::snprintf(error, sizeof(error), "memory layout changed, hash %016llx instead of %016llx",
+                      static_cast<unsigned long long>(newLayoutHash), static_cast<unsigned long long>(layoutHash));
+        // nothing of it ran yet, so it can go
+        dlclose(newHandle);
+        ++rejectCount;
+        return Reload::Rejected;
+    }
+
+    game.setDrawBufferThreadCount(1);
+    game = functions;
+    game.setDrawBufferThreadCount(drawThreadCount);
+    handle = newHandle;
+    ++reloadCount;
+    return Reload::Reloaded;
+}
+
+
+extern "C" {
+
+Vec2f clipSpaceDrawBufferScale(unsigned int viewportWidth, unsigned int viewportHeight)
+{
+    return game.clipSpaceDrawBufferScale(viewportWidth, viewportHeight);
+}
+
+void cleanInput(GameInput* input)
+{
+    game.cleanInput(input);
+}
+
+GameOutput doGameThings(GameInput* input, void* memory, PlatformCallbacks callbacks)
+{
+    return game.doGameThings(input, memory, callbacks);
+}
+
+void writeDrawBuffer(void* memory, void* buffer)
+{
+    game.writeDrawBuffer(memory, buffer);
+}
+
+unsigned writeDrawBufferRows(void* memory, void* buffer, DrawBufferRows* spans, unsigned maxSpans)
+{
+    return game.writeDrawBufferRows(memory, buffer, spans, maxSpans);
+}
+
+void setDrawBufferThreadCount(unsigned threadCount)
+{
+    drawThreadCount = threadCount;
+    game.setDrawBufferThreadCount(threadCount);
+}
+
+void invalidateDrawBuffer(void* memory)
+{
+    game.invalidateDrawBuffer(memory);
+}
+
+int printMemoryLayout(void* memory, char* buffer, int bufferSize)
+{
+    return game.printMemoryLayout(memory, buffer, bufferSize);
+}
+
+unsigned long long gameMemoryInUse(void* memory)
+{
+    return game.gameMemoryInUse(memory);
+}
+
+unsigned long long gameMemoryLayoutHash(void* memory)
+{
+    return game.gameMemoryLayoutHash(memory);
+}
+
+int printProfilingZones(char* buffer, int bufferSize)
+{
+    return game.printProfilingZones(buffer, bufferSize);
+}
+
+void clearProfilingZones(void)
+{
+    game.clearProfilingZones();
+}
+
+void writeAudioBuffer(void* memory, void* buffer, AudioBufferDescriptor bufferDescriptor)
+{
+    game.writeAudioBuffer(memory, buffer, bufferDescriptor);
+}
+
+long long lastAudioBufferLockWait(void)
+{
+    return game.lastAudioBufferLockWait();
+}
+
+}
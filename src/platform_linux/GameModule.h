@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+#include "../game/Project256.h"
+
+// The game code as a shared object for the hot reloading host. GameModule.cpp
+// defines the functions of Project256.h to forward to the version loaded last,
+// so the rest of the host calls them as if the game were linked in.
+//
+// A new version takes over the same memory block between two frames, unless its
+// gameMemoryLayoutHash differs from the running one's: then it is rejected and
+// the running version carries on. Versions that were replaced stay mapped, the
+// memory may still point at their constant data.
+struct GameModule {
+    enum class Reload {
+        Unchanged,
+        Reloaded,
+        Rejected
+    };
+
+    const char* path{};
+    void* handle{};
+    // modification time of the file the loaded version, or the last rejected one, came from
+    timespec modified{};
+    uint64_t layoutHash{};
+    unsigned reloadCount{};
+    unsigned rejectCount{};
+    // why the last load or reload failed
+    char error[256]{};
+
+    // the first version, false if it could not be loaded
+    bool load(const char* modulePath, void* memory);
+    // loads the file again if it changed since, call between frames
+    Reload reloadIfChanged(void* memory);
+};
@@ -0,0 +1,264 @@
+#include "GameState.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numbers>
+#include <string>
+#include <unistd.h>
+
+TimingData GameState::timingData{
+    .getPlatformTimeMicroseconds = []() -> int64_t {
+        timespec now{};
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return static_cast<int64_t>(now.tv_sec) * 1'000'000 + now.tv_nsec / 1'000;
+    }
+};
+
+// about what a texture upload API takes in one go before more calls cost more than the extra rows
+constant unsigned MaxUploadSpans = 8;
+
+inline internalfunc void pressButton(Button& button, bool isDown) {
+    button.transitionCount += isDown != button.endedDown ? 1 : 0;
+    button.endedDown = isDown;
+}
+
+void SyntheticInput::updateGameInput(GameInput& gameInput) {
+    upTime += frameStep_microseconds;
+    gameInput.elapsedTime_s = double(frameStep_microseconds) / 1'000'000;
+    gameInput.upTime_microseconds = upTime;
+    gameInput.frameNumber = frameCount++;
+
+    GameController& kbm = gameInput.controllers[0];
+    kbm.subType = ControllerSubTypeKeyboardAndMouse;
+    kbm.isConnected = true;
+    kbm.isActive = true;
+
+    // walk the dPad clockwise, one direction per second
+    const uint64_t direction = (frameCount / 60) % 4;
+    pressButton(kbm.dPad.up, direction == 0);
+    pressButton(kbm.dPad.right, direction == 1);
+    pressButton(kbm.dPad.down, direction == 2);
+    pressButton(kbm.dPad.left, direction == 3);
+
+    auto& mouse = gameInput.mouse;
+    const float angle = 2 * std::numbers::pi_v<float> * static_cast<float>(frameCount % 240) / 240;
+    const Vec2f position{
+        .x = DrawBufferWidth * (0.5f + 0.4f * std::cos(angle)),
+        .y = DrawBufferHeight * (0.5f + 0.4f * std::sin(angle)),
+    };
+    if (mouse.trackLength < InputMouseMaxTrackLength) {
+        mouse.track[mouse.trackLength++] = position;
+    }
+    mouse.endedOver = true;
+
+    if (clickPeriod > 0) {
+        const uint64_t phase = frameCount % clickPeriod;
+        if (phase == 0) {
+            pressButton(mouse.buttonLeft, true);
+        } else if (phase == static_cast<uint64_t>(clickPeriod) / 2) {
+            pressButton(mouse.buttonLeft, false);
+        }
+    }
+}
+
+
+internalfunc std::string makeFilePath(const char* filename) {
+    std::string pathBuf(512, '\0');
+    ssize_t length = readlink("/proc/self/exe", pathBuf.data(), pathBuf.size());
+    pathBuf.resize(length > 0 ? length : 0);
+    size_t lastSlashPos = pathBuf.find_last_of('/');
+    if (lastSlashPos != std::string::npos) pathBuf.erase(lastSlashPos + 1);
+    return pathBuf + filename;
+}
+
+
+long long readFileDEBUG(const char* filename, unsigned char* buffer, long long bufferSize) {
+    auto filePath = makeFilePath(filename);
+    FILE* file = std::fopen(filePath.c_str(), "rb");
+    if (!file) {
+        std::fprintf(stderr, "Could not open %s\n", filePath.c_str());
+        exit(1);
+    }
+    size_t read = std::fread(buffer, 1, static_cast<size_t>(bufferSize), file);
+    std::fclose(file);
+    return static_cast<long long>(read);
+}
+
+
+// reads uncompressed 32 bit BMP files, which is what the assets are stored as
+bool readImageDEBUG(const char* filename, unsigned int* buffer, int width, int height)
+{
+    auto filePath = makeFilePath(filename);
+    FILE* file = std::fopen(filePath.c_str(), "rb");
+    if (!file)
+        return false;
+
+    uint8_t header[54]{};
+    if (std::fread(header, 1, sizeof(header), file) != sizeof(header) || header[0] != 'B' || header[1] != 'M') {
+        std::fclose(file);
+        return false;
+    }
+
+    auto readInt32 = [&](int offset) {
+        int32_t value;
+        std::memcpy(&value, header + offset, sizeof(value));
+        return value;
+    };
+    const int32_t dataOffset = readInt32(10);
+    const int32_t fileWidth = readInt32(18);
+    const int32_t fileHeight = readInt32(22);
+    const int bitsPerPixel = header[28] | header[29] << 8;
+    const int32_t compression = readInt32(30);
+    if (bitsPerPixel != 32 || (compression != 0 && compression != 3)) {
+        std::fclose(file);
+        return false;
+    }
+
+    const bool topDown = fileHeight < 0;
+    const int rows = std::min(height, std::abs(fileHeight));
+    const int columns = std::min(width, fileWidth);
+    bool success = true;
+    for (int row = 0; row < rows && success; ++row) {
+        const long fileRow = topDown ? row : std::abs(fileHeight) - 1 - row;
+        success = std::fseek(file, dataOffset + fileRow * fileWidth * 4, SEEK_SET) == 0
+            && std::fread(buffer + row * width, 4, columns, file) == static_cast<size_t>(columns);
+    }
+    std::fclose(file);
+    return success;
+}
+
+void logStringDEBUG(const char* utf8NullTerminatedString)
+{
+    std::fprintf(stderr, "%s\n", utf8NullTerminatedString);
+}
+
+
+GameState::GameState()
+{
+    this->memory = reinterpret_cast<uint8_t*>(std::aligned_alloc(128, MemorySize));
+    this->drawBuffer = reinterpret_cast<uint8_t*>(std::aligned_alloc(128, 4 * DrawBufferHeight * DrawBufferWidth));
+    this->audioBuffer = reinterpret_cast<uint8_t*>(std::aligned_alloc(128, AudioFramesPerBuffer * AudioBitsPerSample / 8 * AudioChannelsPerFrame));
+    std::memset(this->memory, 0, MemorySize);
+
+    audioBufferDescriptor.channelsPerFrame = AudioChannelsPerFrame;
+    audioBufferDescriptor.framesPerBuffer = AudioFramesPerBuffer;
+    audioBufferDescriptor.sampleRate = AudioFramesPerSecond;
+
+    audioDeadlines.start(0, AudioFramesPerSecond);
+    audioDeadlines.streamStart_ns = audioDeadlines.deadline_ns(0) - audioDeadlines.requested_ns(0);
+}
+
+GameState::~GameState()
+{
+    recorder.close();
+    player.close();
+    std::free(this->memory);
+    std::free(this->drawBuffer);
+    std::free(this->audioBuffer);
+}
+
+
+GameOutput GameState::tick() {
+    profiling_time_interval(&GameState::timingData, eTimerTickToTick, eTimingTickToTick);
+    profiling_time_set(&GameState::timingData, eTimerTickToTick);
+
+    profiling_time_set(&GameState::timingData, eTimerTick);
+
+    GameOutput output{};
+    if (player.isOpen()) {
+        if (!player.next(input)) {
+            replayFinished = true;
+            output.shouldQuit = true;
+            return output;
+        }
+    } else {
+        platform.updateGameInput(input);
+    }
+    if (recorder.isOpen() && !recorder.failed && !recorder.record(input)) {
+        std::fprintf(stderr, "Recording stopped after %llu frames, writing failed: %s\n",
+                     static_cast<unsigned long long>(recorder.frameCount), std::strerror(recorder.error));
+    }
+
+    profiling_time_interval(&GameState::timingData, eTimerTick, eTimingTickSetup);
+    perf.begin(eTimingTickDo);
+    const uint64_t allocationsBefore = heapAllocationCount();
+    output = doGameThings(&input, memory, {
+        .readFile = readFileDEBUG,
+        .readImage = readImageDEBUG,
+        .log = logStringDEBUG,
+        });
+    if (input.frameNumber > 0) {
+        tickAllocationCount += heapAllocationCount() - allocationsBefore;
+    }
+    perf.end(eTimingTickDo, 1);
+    profiling_time_interval(&GameState::timingData, eTimerTick, eTimingTickDo);
+
+    cleanInput(&input);
+    profiling_time_interval(&GameState::timingData, eTimerTick, eTimingTickPost);
+
+    // writeDrawBuffer's state is in the block too, rewinding it is safe because draw() runs on this thread
+    if (rewind.isInitialized()) {
+        rewind.snapshot(memory, gameMemoryInUse(memory));
+        profiling_time_interval(&GameState::timingData, eTimerTick, eTimingRewindSnapshot);
+    }
+
+    return output;
+}
+
+void GameState::draw() {
+    profiling_time_interval(&GameState::timingData, eTimerFrameToFrame, eTimingFrameToFrame);
+    profiling_time_set(&GameState::timingData, eTimerFrameToFrame);
+
+    profiling_time_set(&GameState::timingData, eTimerBufferCopy);
+    perf.begin(eTimingBufferCopy);
+    DrawBufferRows spans[MaxUploadSpans];
+    const unsigned spanCount = writeDrawBufferRows(memory, drawBuffer, spans, MaxUploadSpans);
+    profiling_time_interval(&GameState::timingData, eTimerBufferCopy, eTimingBufferCopy);
+
+    uint64_t rowCount = 0;
+    for (unsigned i = 0; i < spanCount; ++i) {
+        rowCount += spans[i].count;
+    }
+    perf.end(eTimingBufferCopy, rowCount * DrawBufferWidth);
+    changedSpanCount += spanCount;
+    changedRowCount += rowCount;
+}
+
+uint64_t GameState::drawBufferChecksum() const {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < 4 * DrawBufferHeight * DrawBufferWidth; ++i) {
+        hash = (hash ^ drawBuffer[i]) * 0x100000001b3;
+    }
+    return hash;
+}
+
+void GameState::writeAudio() {
+    profiling_time_interval(&GameState::timingData, eTimerAudioBufferToAudioBuffer, eTimingAudioBufferToAudioBuffer);
+    profiling_time_set(&GameState::timingData, eTimerAudioBufferToAudioBuffer);
+
+    profiling_time_set(&GameState::timingData, eTimerFillAudioBuffer);
+    perf.begin(eTimingFillAudioBuffer);
+    const int64_t start_ns = AudioDeadlines::now_ns();
+    writeAudioBuffer(memory, audioBuffer, audioBufferDescriptor);
+    const int64_t elapsed_ns = AudioDeadlines::now_ns() - start_ns;
+    perf.end(eTimingFillAudioBuffer, audioBufferDescriptor.framesPerBuffer);
+    profiling_time_interval(&GameState::timingData, eTimerFillAudioBuffer, eTimingFillAudioBuffer);
+
+    const int64_t callStart_ns = input.upTime_microseconds * 1'000;
+    audioDeadlines.record(audioBufferDescriptor.sampleTime, callStart_ns, callStart_ns + elapsed_ns, lastAudioBufferLockWait());
+
+    audioBufferDescriptor.timestamp = input.upTime_microseconds;
+    audioBufferDescriptor.sampleTime += audioBufferDescriptor.framesPerBuffer;
+}
+
+int GameState::fillAudio() {
+    int buffersWritten = 0;
+    const double gameSampleTime = input.upTime_microseconds * audioBufferDescriptor.sampleRate / 1'000'000;
+    while (audioBufferDescriptor.sampleTime < gameSampleTime) {
+        writeAudio();
+        ++buffersWritten;
+    }
+    return buffersWritten;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstdint>
+#include <time.h>
+#include "../game/Project256.h"
+#include "../game/Profiling/Timings.h"
+#include "../game/Profiling/AudioDeadlines.hpp"
+#include "PerfCounters.h"
+#include "../game/Utility/InputRecording.hpp"
+#include "../game/Utility/Rewind.hpp"
+
+class Chronometer {
+    int lastTimeIndex = 0;
+    timespec timevalues[2] = {};
+public:
+    struct Time {
+        int64_t microseconds;
+        double seconds;
+    };
+
+    Time elapsed() {
+        int nextTimeIndex = (this->lastTimeIndex == 0 ? 1 : 0);
+        clock_gettime(CLOCK_MONOTONIC, &timevalues[nextTimeIndex]);
+        auto t0 = timevalues[lastTimeIndex];
+        auto t1 = timevalues[nextTimeIndex];
+        this->lastTimeIndex = nextTimeIndex;
+        int64_t elapsedMicroseconds = (t1.tv_sec - t0.tv_sec) * 1'000'000 + (t1.tv_nsec - t0.tv_nsec) / 1'000;
+        return Time{
+            .microseconds = elapsedMicroseconds,
+            .seconds = double(elapsedMicroseconds) / 1'000'000
+        };
+    }
+
+    Chronometer() {
+        clock_gettime(CLOCK_MONOTONIC, &timevalues[lastTimeIndex]);
+    }
+};
+
+
+// Scripted input for the headless host: the mouse circles the draw buffer,
+// clicks every `clickPeriod` frames and the keyboard controller walks the dPad.
+struct SyntheticInput {
+    uint64_t frameCount{};
+    int64_t upTime{};
+    int64_t frameStep_microseconds = 16'667;
+    int clickPeriod = 30;
+
+    void updateGameInput(GameInput& gameInput);
+};
+
+
+// operator new calls so far, counted by the headless host
+uint64_t heapAllocationCount();
+
+struct GameState {
+    static TimingData timingData;
+    uint8_t* memory;
+    uint8_t* drawBuffer;
+    uint8_t* audioBuffer;
+    GameInput input{};
+    AudioBufferDescriptor audioBufferDescriptor{};
+
+    SyntheticInput platform{};
+    InputRecording::Recorder recorder{};
+    // when open, input comes from the recording instead of `platform`
+    InputRecording::Player player{};
+    bool replayFinished{};
+    // what a texture upload would have cost: rows writeDrawBuffer changed, in how many spans
+    uint64_t changedRowCount{};
+    uint64_t changedSpanCount{};
+    // heap allocations made during doGameThings after the first frame, which loads the assets
+    uint64_t tickAllocationCount{};
+    // simulated in game time: a buffer is requested once the game clock passes its sample time and
+    // is due AudioBufferCount - 1 buffers later, the call itself takes as long as it really does
+    AudioDeadlines::Monitor audioDeadlines{};
+    // hardware counters for the intervals enabled in it, nothing unless asked for
+    PerfIntervals perf{};
+    // once initialized, the game memory is snapshot after every tick
+    Rewind::Buffer rewind{};
+
+    GameState();
+    ~GameState();
+    GameState(const GameState&) = delete;
+    GameState& operator=(const GameState&) = delete;
+
+    GameOutput tick();
+    void draw();
+    // FNV-1a over the draw buffer, to compare the output of two runs
+    uint64_t drawBufferChecksum() const;
+    // writes one buffer and advances the descriptor's sample time
+    void writeAudio();
+    // fills audio buffers until the sample clock has caught up with the game's up time
+    int fillAudio();
+};
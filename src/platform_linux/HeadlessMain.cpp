@@ -0,0 +1,393 @@
+//
+//  HeadlessMain.cpp
+//  Project256
+//
+//  Windowless host for Linux: runs a number of frames as fast as possible
+//  and reports the per-stage timings collected in Profiling/Timings.
+//
+
+#include "GameState.h"
+#include "AudioRenderer.h"
+#include "PerfCounters.h"
+#ifdef GAME_HOT_RELOAD
+#include "GameModule.h"
+#endif
+#include "Drawing/PaletteExpansion.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+
+internalfunc void printUsage(const char* name) {
+    std::fprintf(stderr,
+        "usage: %s [--frames N] [--step-us N] [--no-draw] [--draw-threads N] [--no-audio] [--record FILE | --replay FILE] [--trace FILE] [--perf] [--layout] [--rewind MB]\n"
+        "       %s --render-audio FILE [--buffers N] [--quiet]\n"
+        "       %s --bench-palette\n"
+        "  --frames N    number of game ticks to run (default 600)\n"
+        "  --step-us N   simulated frame time in microseconds (default 16667)\n"
+        "  --no-draw     skip writeDrawBuffer\n"
+        "  --draw-threads N  threads writeDrawBuffer may split the buffer across (default 1)\n"
+        "  --no-audio    skip writeAudioBuffer\n"
+        "  --record FILE write the input of every frame to FILE\n"
+        "  --replay FILE take the input from a recording, stops at its end\n"
+        "  --trace FILE  write the last profiling events as Chrome trace JSON\n"
+        "  --layout      print the layout of the game memory after the run\n"
+        "  --perf        count cycles, instructions and misses per tick, pixel and sample\n"
+        "  --rewind MB   snapshot the game memory after every tick into a history of at most MB megabytes,\n"
+        "                then check that rewinding it gives back the memory of earlier ticks and what they drew\n"
+        "  --render-audio FILE  tick once, then write N audio buffers back to back into a WAV file\n"
+        "  --buffers N   number of buffers to render (default 1000)\n"
+        "  --quiet       only print the summary of the audio rendering\n"
+        "  --bench-palette  time every palette expansion kernel on random frames and show which one wins\n", name, name, name);
+#ifdef GAME_HOT_RELOAD
+    std::fprintf(stderr,
+        "  --game FILE   the game module to run and reload whenever FILE changes (default libProject256.so next to %s)\n", name);
+#endif
+}
+
+globalvar std::atomic<uint64_t> allocationCount{};
+
+uint64_t heapAllocationCount() {
+    return allocationCount.load(std::memory_order_relaxed);
+}
+
+// counts every allocation so the summary can show whether the tick allocates
+void* operator new(std::size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+// how far back the --rewind check goes
+constant size_t RewindCheckFrames = 60;
+
+struct MemoryHash {
+    uint64_t hash;
+    size_t size;
+};
+
+internalfunc MemoryHash hashMemory(const uint8_t* memory, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, memory + i, sizeof(word));
+        hash = (hash ^ word) * 1099511628211ull;
+    }
+    return { hash, size };
+}
+
+internalfunc int benchmarkPaletteExpansion() {
+    using namespace PaletteExpansion;
+    constant size_t PixelCount = DrawBufferWidth * DrawBufferHeight;
+    auto tables = std::make_unique<Tables>();
+    auto source = std::make_unique<uint8_t[]>(PixelCount);
+    auto destination = std::make_unique<uint32_t[]>(PixelCount);
+
+    std::printf("%-14s %10s %10s\n", "ns/pixel", "16 colors", "256 colors");
+    std::array<double, KernelCount> results[2];
+    Kernel fastest[2];
+    std::mt19937 random{256};
+    uint32_t palette[256];
+    for (uint32_t& color : palette) {
+        color = 0xFF000000 | (random() & 0xFFFFFF);
+    }
+    for (int run = 0; run < 2; ++run) {
+        const size_t colorCount = run == 0 ? 16 : 256;
+        for (size_t i = 0; i < PixelCount; ++i) {
+            source[i] = static_cast<uint8_t>(random() % colorCount);
+        }
+        tables->build(palette, colorCount);
+        fastest[run] = benchmark(*tables, source.get(), destination.get(), PixelCount, 50, &results[run]);
+    }
+    for (size_t k = 0; k < KernelCount; ++k) {
+        std::printf("%-14s %10.3f %10.3f\n", kernelName(static_cast<Kernel>(k)), results[0][k], results[1][k]);
+    }
+    std::printf("fastest: %s for 16 colors, %s for 256 colors\n", kernelName(fastest[0]), kernelName(fastest[1]));
+
+    // the source still holds the 256 color frame
+    PerfCounters counters{};
+    if (!counters.open()) {
+        std::printf("no hardware counters: %s\n", std::strerror(counters.error));
+        return 0;
+    }
+    std::printf("%-14s %9s %9s %9s %9s %9s (per pixel, 256 colors)\n", "counters", "cycles", "instr", "IPC", "L1D", "LLC");
+    constant int Repetitions = 20;
+    for (size_t k = 0; k < KernelCount; ++k) {
+        const auto kernel = static_cast<Kernel>(k);
+        if (!isUsable(kernel, *tables))
+            continue;
+        expand(kernel, *tables, source.get(), destination.get(), PixelCount);
+        const auto before = counters.read();
+        for (int r = 0; r < Repetitions; ++r) {
+            expand(kernel, *tables, source.get(), destination.get(), PixelCount);
+        }
+        const auto after = counters.read();
+        auto perPixel = [&](PerfCounters::Counter counter) {
+            return double(after.counts[counter] - before.counts[counter]) / (double(PixelCount) * Repetitions);
+        };
+        const double cycles = perPixel(PerfCounters::eCycles);
+        std::printf("%-14s %9.3f %9.3f %9.2f %9.4f %9.4f\n", kernelName(kernel), cycles,
+                    perPixel(PerfCounters::eInstructions),
+                    cycles > 0 ? perPixel(PerfCounters::eInstructions) / cycles : 0.0,
+                    perPixel(PerfCounters::eL1DMisses), perPixel(PerfCounters::eLLCMisses));
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    constant int PROFILING_STR_BUFFER_LENGTH = TimingPrintBufferSize;
+    long long frameCount = 600;
+    long long frameStep = 16'667;
+    bool shouldDraw = true;
+    unsigned drawThreadCount = 1;
+    bool shouldFillAudio = true;
+    const char* recordFilename = nullptr;
+    const char* replayFilename = nullptr;
+    const char* traceFilename = nullptr;
+    const char* audioFilename = nullptr;
+    int audioBufferTarget = 1000;
+    bool shouldCountPerf = false;
+    bool shouldPrintLayout = false;
+    long long rewindMegabytes = 0;
+    bool printEachBuffer = true;
+#ifdef GAME_HOT_RELOAD
+    const char* gameModulePath = nullptr;
+#endif
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frameCount = std::atoll(argv[++i]);
+        } else if (std::strcmp(argv[i], "--step-us") == 0 && i + 1 < argc) {
+            frameStep = std::atoll(argv[++i]);
+        } else if (std::strcmp(argv[i], "--no-draw") == 0) {
+            shouldDraw = false;
+        } else if (std::strcmp(argv[i], "--draw-threads") == 0 && i + 1 < argc) {
+            drawThreadCount = static_cast<unsigned>(std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--no-audio") == 0) {
+            shouldFillAudio = false;
+        } else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordFilename = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayFilename = argv[++i];
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            traceFilename = argv[++i];
+        } else if (std::strcmp(argv[i], "--render-audio") == 0 && i + 1 < argc) {
+            audioFilename = argv[++i];
+        } else if (std::strcmp(argv[i], "--buffers") == 0 && i + 1 < argc) {
+            audioBufferTarget = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--layout") == 0) {
+            shouldPrintLayout = true;
+        } else if (std::strcmp(argv[i], "--rewind") == 0 && i + 1 < argc) {
+            rewindMegabytes = std::atoll(argv[++i]);
+        } else if (std::strcmp(argv[i], "--perf") == 0) {
+            shouldCountPerf = true;
+        } else if (std::strcmp(argv[i], "--quiet") == 0) {
+            printEachBuffer = false;
+#ifdef GAME_HOT_RELOAD
+        } else if (std::strcmp(argv[i], "--game") == 0 && i + 1 < argc) {
+            gameModulePath = argv[++i];
+#endif
+        } else if (std::strcmp(argv[i], "--bench-palette") == 0) {
+            return benchmarkPaletteExpansion();
+        } else {
+            printUsage(argv[0]);
+            return 2;
+        }
+    }
+    if (recordFilename && replayFilename) {
+        printUsage(argv[0]);
+        return 2;
+    }
+
+    GameState gameState{};
+#ifdef GAME_HOT_RELOAD
+    const std::string executable = argv[0];
+    const std::string defaultModulePath = executable.substr(0, executable.find_last_of('/') + 1) + "libProject256.so";
+    GameModule gameModule{};
+    if (!gameModule.load(gameModulePath ? gameModulePath : defaultModulePath.c_str(), gameState.memory)) {
+        std::fprintf(stderr, "Could not load the game: %s\n", gameModule.error);
+        return 1;
+    }
+#endif
+    setDrawBufferThreadCount(drawThreadCount);
+    gameState.platform.frameStep_microseconds = frameStep;
+    if (recordFilename && !gameState.recorder.open(recordFilename)) {
+        std::fprintf(stderr, "Could not open %s for recording: %s\n", recordFilename, std::strerror(gameState.recorder.error));
+        return 1;
+    }
+    if (replayFilename && !gameState.player.open(replayFilename)) {
+        std::fprintf(stderr, "Could not open %s as input recording\n", replayFilename);
+        return 1;
+    }
+
+    if (shouldCountPerf) {
+        if (gameState.perf.enable(eTimingTickDo, "tick")) {
+            gameState.perf.enable(eTimingBufferCopy, "pixel");
+            gameState.perf.enable(eTimingFillAudioBuffer, "sample");
+        } else {
+            std::fprintf(stderr, "No hardware counters, continuing without: %s\n", std::strerror(gameState.perf.counters.error));
+        }
+    }
+
+    if (rewindMegabytes > 0 && !gameState.rewind.init(MemorySize, static_cast<size_t>(rewindMegabytes) << 20)) {
+        std::fprintf(stderr, "%lld MB are not enough for a rewind history of the %ld byte game memory\n", rewindMegabytes, MemorySize);
+        return 1;
+    }
+
+    profiling_trace_name_thread("main");
+    profiling_time_set(&GameState::timingData, eTimerTickToTick);
+    profiling_time_set(&GameState::timingData, eTimerFrameToFrame);
+    profiling_time_set(&GameState::timingData, eTimerAudioBufferToAudioBuffer);
+
+    if (audioFilename) {
+        gameState.tick();
+        AudioRenderer renderer{ .printEachBuffer = printEachBuffer };
+        return renderer.render(gameState, audioFilename, audioBufferTarget) < 0 ? 1 : 0;
+    }
+
+    Chronometer wallTime{};
+    long long audioBufferCount = 0;
+    long long frame = 0;
+    MemoryHash rewindHashes[RewindCheckFrames]{};
+    uint64_t rewindDrawChecksums[RewindCheckFrames]{};
+    for (; frame < frameCount; ++frame) {
+#ifdef GAME_HOT_RELOAD
+        switch (gameModule.reloadIfChanged(gameState.memory)) {
+            case GameModule::Reload::Reloaded:
+                std::printf("frame %lld: reloaded %s\n", frame, gameModule.path);
+                break;
+            case GameModule::Reload::Rejected:
+                std::fprintf(stderr, "frame %lld: kept the running game, %s\n", frame, gameModule.error);
+                break;
+            default:
+                break;
+        }
+#endif
+        const auto output = gameState.tick();
+        if (gameState.replayFinished) {
+            break;
+        }
+        if (gameState.rewind.isInitialized()) {
+            rewindHashes[gameState.rewind.snapshotCount % RewindCheckFrames] = hashMemory(gameState.memory, gameState.rewind.extent);
+        }
+        if (shouldDraw) {
+            gameState.draw();
+            if (gameState.rewind.isInitialized()) {
+                rewindDrawChecksums[gameState.rewind.snapshotCount % RewindCheckFrames] = gameState.drawBufferChecksum();
+            }
+        }
+        if (shouldFillAudio) {
+            audioBufferCount += gameState.fillAudio();
+        }
+        if (output.shouldQuit) {
+            ++frame;
+            break;
+        }
+    }
+    const auto elapsed = wallTime.elapsed();
+
+    char profilingStringBuffer[PROFILING_STR_BUFFER_LENGTH]{};
+    profiling_time_print(&GameState::timingData, profilingStringBuffer, PROFILING_STR_BUFFER_LENGTH);
+
+    std::printf("%lld frames, %lld audio buffers in %.3f s (%.1f frames/s)\n",
+                frame, audioBufferCount, elapsed.seconds, elapsed.seconds > 0 ? frame / elapsed.seconds : 0.0);
+    if (gameState.recorder.isOpen()) {
+        // closing flushes, a full disk may only show here
+        const bool isComplete = gameState.recorder.close();
+        std::printf("recorded %llu frames in %llu bytes\n",
+                    static_cast<unsigned long long>(gameState.recorder.frameCount),
+                    static_cast<unsigned long long>(gameState.recorder.bytesWritten));
+        if (!isComplete) {
+            std::fprintf(stderr, "Recording to %s failed, it is cut short: %s\n", recordFilename, std::strerror(gameState.recorder.error));
+            return 1;
+        }
+    }
+#ifdef GAME_HOT_RELOAD
+    std::printf("game module: %u reloads, %u rejected\n", gameModule.reloadCount, gameModule.rejectCount);
+#endif
+    std::printf("heap allocations in doGameThings after the first frame: %llu\n",
+                static_cast<unsigned long long>(gameState.tickAllocationCount));
+    if (shouldDraw && frame > 0) {
+        std::printf("draw buffer: %.1f changed rows in %.2f spans per frame, checksum %016llx\n",
+                    double(gameState.changedRowCount) / frame, double(gameState.changedSpanCount) / frame,
+                    static_cast<unsigned long long>(gameState.drawBufferChecksum()));
+    }
+    std::printf("%-18s %6s %7s %7s %7s %7s %7s %7s %7s (us)\n", "interval", "count", "mean", "min", "p50", "p90", "p99", "p99.9", "max");
+    std::printf("%s", profilingStringBuffer);
+
+    if (shouldFillAudio && gameState.audioDeadlines.bufferCount > 0) {
+        char deadlineStringBuffer[512]{};
+        // the game clock steps --step-us per tick instead of running in real time, only the call durations are real
+        gameState.audioDeadlines.print(deadlineStringBuffer, sizeof(deadlineStringBuffer), "simulated audio deadlines");
+        std::printf("%s", deadlineStringBuffer);
+    }
+
+    if (gameState.rewind.isInitialized()) {
+        Rewind::Buffer& rewind = gameState.rewind;
+        std::printf("rewind: %zu frames back in %.2f of %.2f MB, last frame %zu bytes of %zu tracked\n",
+                    rewind.depth(), rewind.bytesInUse() / 1048576.0, rewindMegabytes * 1.0,
+                    rewind.lastSnapshotSize, rewind.extent);
+        const size_t back = rewind.depth() < RewindCheckFrames - 1 ? rewind.depth() : RewindCheckFrames - 1;
+        if (back > 0) {
+            const size_t checked = (rewind.snapshotCount - back) % RewindCheckFrames;
+            const MemoryHash& expected = rewindHashes[checked];
+            const bool restored = rewind.rewind(back, gameState.memory)
+                && hashMemory(gameState.memory, expected.size).hash == expected.hash;
+            std::printf("rewind: %zu frames back %s\n", back, restored ? "matches" : "DOES NOT MATCH");
+            if (!restored)
+                return 1;
+            if (shouldDraw) {
+                // the draw buffer still shows the newest frame, while the memory says an older one was expanded
+                invalidateDrawBuffer(gameState.memory);
+                gameState.draw();
+                const bool redrawn = gameState.drawBufferChecksum() == rewindDrawChecksums[checked];
+                std::printf("rewind: draw buffer after it %s\n", redrawn ? "matches" : "DOES NOT MATCH");
+                if (!redrawn)
+                    return 1;
+            }
+        }
+    }
+
+    if (gameState.perf.counters.isOpen()) {
+        char perfStringBuffer[PROFILING_STR_BUFFER_LENGTH]{};
+        gameState.perf.print(perfStringBuffer, PROFILING_STR_BUFFER_LENGTH);
+        std::printf("%s", perfStringBuffer);
+    }
+
+    char zonesStringBuffer[PROFILING_STR_BUFFER_LENGTH]{};
+    if (printProfilingZones(zonesStringBuffer, PROFILING_STR_BUFFER_LENGTH) > 0) {
+        std::printf("%s", zonesStringBuffer);
+    }
+
+    if (shouldPrintLayout) {
+        constant int LayoutBufferSize = 8192;
+        char layoutStringBuffer[LayoutBufferSize]{};
+        printMemoryLayout(gameState.memory, layoutStringBuffer, LayoutBufferSize);
+        std::printf("%s", layoutStringBuffer);
+    }
+
+    if (traceFilename) {
+        const int eventCount = profiling_trace_write_json(traceFilename);
+        if (eventCount < 0) {
+            std::fprintf(stderr, "Could not write trace to %s: %s\n", traceFilename, std::strerror(errno));
+            return 1;
+        }
+        std::printf("wrote %d trace events to %s\n", eventCount, traceFilename);
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+#include "PerfCounters.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+internalfunc int perfEventOpen(perf_event_attr& attributes, int groupFd) {
+    return static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, groupFd, 0));
+}
+
+internalfunc perf_event_attr attributesFor(PerfCounters::Counter counter) {
+    perf_event_attr attributes{};
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    switch (counter) {
+        case PerfCounters::eCycles:
+            attributes.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PerfCounters::eInstructions:
+            attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PerfCounters::eL1DMisses:
+            attributes.type = PERF_TYPE_HW_CACHE;
+            attributes.config = PERF_COUNT_HW_CACHE_L1D
+                | PERF_COUNT_HW_CACHE_OP_READ << 8
+                | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+            break;
+        case PerfCounters::eLLCMisses:
+            attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case PerfCounters::eBranchMisses:
+            attributes.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        default:
+            break;
+    }
+    // user space only, which perf_event_paranoid 2 still allows
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID
+        | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return attributes;
+}
+
+bool PerfCounters::open()
+{
+    close();
+    for (int counter = 0; counter < CounterCount; ++counter) {
+        perf_event_attr attributes = attributesFor(static_cast<Counter>(counter));
+        attributes.disabled = groupFd < 0 ? 1 : 0;
+        const int fd = perfEventOpen(attributes, groupFd);
+        if (fd < 0) {
+            error = error ? error : errno;
+            continue;
+        }
+        if (ioctl(fd, PERF_EVENT_IOC_ID, &ids[counter]) != 0) {
+            ::close(fd);
+            continue;
+        }
+        fds[counter] = fd;
+        groupFd = groupFd < 0 ? fd : groupFd;
+    }
+    if (groupFd < 0)
+        return false;
+    ioctl(groupFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(groupFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+}
+
+void PerfCounters::close()
+{
+    // the leader goes last
+    for (int counter = CounterCount; counter-- > 0;) {
+        if (fds[counter] >= 0 && fds[counter] != groupFd) {
+            ::close(fds[counter]);
+        }
+        fds[counter] = -1;
+    }
+    if (groupFd >= 0) {
+        ::close(groupFd);
+        groupFd = -1;
+    }
+}
+
+PerfCounters::Values PerfCounters::read() const
+{
+    Values values{};
+    if (groupFd < 0)
+        return values;
+
+    // nr, time enabled, time running, then a value and id per counter
+    uint64_t data[3 + 2 * CounterCount]{};
+    const ssize_t size = ::read(groupFd, data, sizeof(data));
+    if (size < static_cast<ssize_t>(3 * sizeof(uint64_t)) || data[2] == 0)
+        return values;
+    const uint64_t maxCount = static_cast<uint64_t>(CounterCount);
+    const uint64_t count = data[0] < maxCount ? data[0] : maxCount;
+    const double scale = double(data[1]) / double(data[2]);
+    for (uint64_t i = 0; i < count; ++i) {
+        const uint64_t value = data[3 + 2 * i];
+        const uint64_t id = data[4 + 2 * i];
+        for (int counter = 0; counter < CounterCount; ++counter) {
+            if (fds[counter] >= 0 && ids[counter] == id) {
+                values.counts[counter] = data[1] == data[2] ? value : static_cast<uint64_t>(value * scale);
+            }
+        }
+    }
+    return values;
+}
+
+const char* PerfCounters::name(Counter counter)
+{
+    switch (counter) {
+        case eCycles: return "cycles";
+        case eInstructions: return "instructions";
+        case eL1DMisses: return "L1D misses";
+        case eLLCMisses: return "LLC misses";
+        case eBranchMisses: return "branch misses";
+        default: return "?";
+    }
+}
+
+
+bool PerfIntervals::enable(TimingInterval interval, const char* unitName)
+{
+    if (!counters.isOpen() && !counters.open())
+        return false;
+    enabled[interval] = true;
+    unitNames[interval] = unitName;
+    return true;
+}
+
+void PerfIntervals::begin(TimingInterval interval)
+{
+    if (enabled[interval]) {
+        started[interval] = counters.read();
+    }
+}
+
+void PerfIntervals::end(TimingInterval interval, uint64_t unitCount)
+{
+    if (!enabled[interval])
+        return;
+    const PerfCounters::Values now = counters.read();
+    for (int counter = 0; counter < PerfCounters::CounterCount; ++counter) {
+        sums[interval].counts[counter] += now.counts[counter] - started[interval].counts[counter];
+    }
+    ++counts[interval];
+    units[interval] += unitCount;
+}
+
+int PerfIntervals::print(char* buffer, int bufferSize) const
+{
+    int writtenTotal = 0;
+    auto printText = [&](const char* format, auto... args) {
+        if (bufferSize <= 0)
+            return;
+        const int written = std::snprintf(buffer, static_cast<size_t>(bufferSize), format, args...);
+        if (written < 0 || written >= bufferSize) {
+            writtenTotal += bufferSize - 1;
+            bufferSize = 0;
+            return;
+        }
+        buffer += written;
+        bufferSize -= written;
+        writtenTotal += written;
+    };
+    // per unit of work, or n/a for counters that are not there
+    auto printPerUnit = [&](TimingInterval interval, PerfCounters::Counter counter) {
+        if (!counters.has(counter) || units[interval] == 0) {
+            printText(" %9s", "n/a");
+        } else {
+            printText(" %9.3f", double(sums[interval].counts[counter]) / units[interval]);
+        }
+    };
+
+    printText("%-18s %6s %10s %9s %9s %9s %9s %9s %9s %9s\n", "counters", "count", "units", "unit",
+              "cycles/u", "instr/u", "IPC", "L1D/u", "LLC/u", "brmiss/u");
+    for (int i = 0; i < TimingIntervalCount; ++i) {
+        const auto interval = static_cast<TimingInterval>(i);
+        if (!enabled[interval])
+            continue;
+        const auto& sum = sums[interval].counts;
+        printText("%-18s %6llu %10llu %9s", profiling_interval_name(interval),
+                  static_cast<unsigned long long>(counts[interval]),
+                  static_cast<unsigned long long>(units[interval]),
+                  unitNames[interval]);
+        printPerUnit(interval, PerfCounters::eCycles);
+        printPerUnit(interval, PerfCounters::eInstructions);
+        if (counters.has(PerfCounters::eCycles) && counters.has(PerfCounters::eInstructions) && sum[PerfCounters::eCycles] > 0) {
+            printText(" %9.2f", double(sum[PerfCounters::eInstructions]) / sum[PerfCounters::eCycles]);
+        } else {
+            printText(" %9s", "n/a");
+        }
+        printPerUnit(interval, PerfCounters::eL1DMisses);
+        printPerUnit(interval, PerfCounters::eLLCMisses);
+        printPerUnit(interval, PerfCounters::eBranchMisses);
+        printText("\n");
+    }
+    return writtenTotal;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include "../game/Profiling/Timings.h"
+
+// Hardware counters of the calling thread through perf_event_open, read as one
+// group so all of them cover the same instructions. Counters the kernel or the
+// machine does not offer are left out; without any, every call does nothing.
+// Work handed to other threads, like the draw worker bands, is not counted.
+struct PerfCounters {
+    enum Counter {
+        eCycles,
+        eInstructions,
+        eL1DMisses,
+        eLLCMisses,
+        eBranchMisses,
+        CounterCount
+    };
+
+    struct Values {
+        uint64_t counts[CounterCount];
+    };
+
+    int groupFd = -1;
+    int fds[CounterCount] = { -1, -1, -1, -1, -1 };
+    uint64_t ids[CounterCount]{};
+    // errno of the first counter that failed to open
+    int error = 0;
+
+    PerfCounters() = default;
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    ~PerfCounters() { close(); }
+
+    // returns whether at least one counter is available
+    bool open();
+    void close();
+    bool isOpen() const { return groupFd >= 0; }
+    bool has(Counter counter) const { return fds[counter] >= 0; }
+    // running totals since open, scaled up if the kernel had to multiplex the group
+    Values read() const;
+
+    static const char* name(Counter counter);
+};
+
+// Sums the counters over the stretches of code measured by chosen TimingIntervals,
+// together with the units of work done, pixels or samples, to normalize them by.
+struct PerfIntervals {
+    PerfCounters counters{};
+    bool enabled[TimingIntervalCount]{};
+    const char* unitNames[TimingIntervalCount]{};
+    PerfCounters::Values started[TimingIntervalCount]{};
+    PerfCounters::Values sums[TimingIntervalCount]{};
+    uint64_t counts[TimingIntervalCount]{};
+    uint64_t units[TimingIntervalCount]{};
+
+    // opens the counters on the first call, false if there are none
+    bool enable(TimingInterval interval, const char* unitName);
+    bool isEnabled(TimingInterval interval) const { return enabled[interval]; }
+    void begin(TimingInterval interval);
+    void end(TimingInterval interval, uint64_t unitCount);
+    // a table with one line per enabled interval
+    int print(char* buffer, int bufferSize) const;
+};
@@ -18,6 +18,8 @@ class PlatformAudio {
     let condition = NSCondition()
     var availableBuffers: [AudioQueueBufferRef] = []
     var queueLock = NSLock()
+    // buffers filled so far, the first AudioBufferCount of them start the queue
+    var bufferCount: UInt32 = 0
 
     init(memory: UnsafeMutableRawPointer) {
         self.memory = memory
@@ -115,7 +117,16 @@ class PlatformAudio {
         AudioQueueDeviceGetCurrentTime(queue, &timestamp)
 
         let descriptor = AudioBufferDescriptor(timestamp: timestamp.mHostTime, sampleTime: timestamp.mSampleTime, sampleRate: Double(AudioFramesPerSecond), framesPerBuffer: framesPerBuffer, channelsPerFrame: 2)
+        let callStart = profiling_audio_now_ns()
         writeAudioBuffer(self.memory, bufferRef.pointee.mAudioData, descriptor)
+        let callEnd = profiling_audio_now_ns()
+        // the queue starts playing with the first buffer, the ones filled right after it were never late
+        if bufferCount == 0 {
+            profiling_audio_start(callEnd, Double(AudioFramesPerSecond))
+        } else if bufferCount >= AudioBufferCount {
+            profiling_audio_record(Double(bufferCount) * Double(framesPerBuffer), callStart, callEnd, lastAudioBufferLockWait())
+        }
+        bufferCount += 1
 
         bufferRef.pointee.mAudioDataByteSize = capacity
         let status = AudioQueueEnqueueBuffer(queue, bufferRef, 0, nil)
@@ -46,10 +46,14 @@ struct Project256App: App {
                     _ in
                     PlatformProfiling.withInstance {
                         profiling in
-                        profilingString = String(unsafeUninitializedCapacity: 1000) {
+                        profilingString = String(unsafeUninitializedCapacity: Int(TimingPrintBufferSize)) {
                             buffer in
                             return Int(profiling.timingData.printTo(buffer: buffer.baseAddress!, size: Int32(buffer.count)))
                         }
+                        profilingString += String(unsafeUninitializedCapacity: 512) {
+                            buffer in
+                            return Int(profiling_audio_print(buffer.baseAddress!, Int32(buffer.count)))
+                        }
                         profiling.timingData.clear()
                     }
                 }
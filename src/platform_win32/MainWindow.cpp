@@ -101,6 +101,8 @@ void MainWindow::onTimer(WPARAM timerId) {
         profiling_time_print(&GameState::timingData, this->profilingStringBuffer, PROFILING_STR_BUFFER_LENGTH);
         profiling_time_clear(&GameState::timingData);
         OutputDebugStringA(this->profilingStringBuffer);
+        profiling_audio_print(this->profilingStringBuffer, PROFILING_STR_BUFFER_LENGTH);
+        OutputDebugStringA(this->profilingStringBuffer);
         break;
     }
 }
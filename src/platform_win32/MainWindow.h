@@ -12,7 +12,7 @@ enum class MouseButtonClick { Down, Up, DoubleClick };
 
 class MainWindow
 {
-    constant int PROFILING_STR_BUFFER_LENGTH = 1000;
+    constant int PROFILING_STR_BUFFER_LENGTH = TimingPrintBufferSize;
     GameState* mGameState;
     HWND mHwnd;
     Direct3D12View* mGameView;
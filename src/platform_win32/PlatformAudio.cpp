@@ -1,4 +1,5 @@
 #include "PlatformAudio.h"
+#include "../game/Profiling/Timings.h"
 #include <cassert>
 
 void ExitOnFail(HRESULT hr) {
@@ -64,13 +65,18 @@ PlatformAudio::PlatformAudio(void* memory) :mMemory{ memory } {
 		}
 	}, mSourceVoiceCallback.mBufferEndEvent };
 
+	// the first buffer the game writes plays once the silent ones submitted above are through
+	const int64_t bufferDuration_ns = static_cast<int64_t>(AudioFramesPerBuffer * 1e9 / mAudioBufferDescriptor.sampleRate);
+	profiling_audio_start(profiling_audio_now_ns() + AudioBufferCount * bufferDuration_ns, mAudioBufferDescriptor.sampleRate);
 	mSourceVoice->Start();
 }
 
 void PlatformAudio::prepareNextBuffer() {
 	XAUDIO2_BUFFER& buf = mBuffers[mCurrentBuffer];
 	void* data = const_cast<void*>(reinterpret_cast<const void*>(buf.pAudioData));
+	const int64_t callStart_ns = profiling_audio_now_ns();
 	writeAudioBuffer(this->mMemory, data, mAudioBufferDescriptor);
+	profiling_audio_record(mAudioBufferDescriptor.sampleTime, callStart_ns, profiling_audio_now_ns(), lastAudioBufferLockWait());
 	mSourceVoice->SubmitSourceBuffer(&buf);
 	//std::stringstream x{};
 	//x << "Submit: " << mCurrentBuffer << "\n";
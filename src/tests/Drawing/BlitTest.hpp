@@ -0,0 +1,99 @@
+//
+//  BlitTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Drawing/Images.hpp"
+#include <random>
+#include <vector>
+
+namespace BlitTest {
+
+using namespace Blit;
+
+void kernelsMatchScalar(Test& t)
+{
+    std::mt19937 random{ 256 };
+    for (size_t k = 0; k < KernelCount; ++k) {
+        const auto kernel = static_cast<Kernel>(k);
+        if (!isSupported(kernel))
+            continue;
+        // every tail length, with the key next to the values whose top bits differ from it
+        for (uint8_t transparent : { uint8_t{0}, uint8_t{0x7f}, uint8_t{0x80}, uint8_t{0xff} }) {
+            for (size_t count = 0; count < 100; ++count) {
+                std::vector<uint8_t> source(count), destination(count), expected(count);
+                for (size_t i = 0; i < count; ++i) {
+                    const uint32_t r = random();
+                    source[i] = r % 3 == 0 ? transparent : static_cast<uint8_t>(transparent ^ (1u << (r >> 8) % 8));
+                    destination[i] = expected[i] = static_cast<uint8_t>(r >> 16);
+                }
+                transparentRowScalar(source.data(), expected.data(), count, transparent);
+                transparentRow(kernel, source.data(), destination.data(), count, transparent);
+                t.expect(destination == expected, true);
+            }
+        }
+    }
+}
+
+void widePixelsStayInTheLine(Test& t)
+{
+    Image<uint16_t, 8, 2> source{};
+    Image<uint16_t, 8, 2> destination{};
+    source.fill(5);
+    source.at({1, 0}) = 0;
+    destination.fill(9);
+    auto from = makeSubImage(source, 0, 0, 4, 2);
+    auto to = makeSubImage(destination, 2, 0, 4, 2);
+    imageBlitWithTransparentColor(from, to, 0);
+    const uint16_t expected[8] = { 9, 9, 5, 9, 5, 5, 9, 9 };
+    for (size_t y = 0; y < 2; ++y) {
+        for (size_t x = 0; x < 8; ++x) {
+            t.expect(destination.lines[y][x], uint16_t(y == 1 && x == 3 ? 5 : expected[x]));
+        }
+    }
+}
+
+void positionedBlitClips(Test& t)
+{
+    Image<uint8_t, 4, 3> sprite{};
+    uint8_t next = 1;
+    sprite.transformPixels([&](uint8_t) { return next++; });
+    sprite.at({0, 0}) = 0;
+
+    for (Vec2i position : { Vec2i{-2, -1}, Vec2i{5, 1}, Vec2i{-4, 0}, Vec2i{7, 5}, Vec2i{6, 4} }) {
+        Image<uint8_t, 9, 6> screen{};
+        screen.fill(0xEE);
+        imageBlitWithTransparentColor(sprite, screen, position, uint8_t{0});
+        for (int y = 0; y < 6; ++y) {
+            for (int x = 0; x < 9; ++x) {
+                const Vec2i inSprite{ x - position.x, y - position.y };
+                uint8_t want = 0xEE;
+                if (inSprite.x >= 0 && inSprite.x < 4 && inSprite.y >= 0 && inSprite.y < 3 && sprite.at(inSprite) != 0) {
+                    want = sprite.at(inSprite);
+                }
+                t.expect(screen.at({x, y}), want);
+            }
+        }
+    }
+
+    // lines of a top down source go into a bottom up destination flipped
+    Image<uint8_t, 4, 3, ImageOrigin::TopLeft> topDown{};
+    topDown.fill(1);
+    topDown.lines[0].fill(2);
+    Image<uint8_t, 4, 3> bottomUp{};
+    imageBlitWithTransparentColor(topDown, bottomUp, Vec2i{0, 0}, uint8_t{0});
+    t.expect(bottomUp.lines[2][0], uint8_t{2});
+    t.expect(bottomUp.lines[0][0], uint8_t{1});
+}
+
+void addAll(Test& t)
+{
+    t.add(kernelsMatchScalar);
+    t.add(widePixelsStayInTheLine);
+    t.add(positionedBlitClips);
+}
+
+}
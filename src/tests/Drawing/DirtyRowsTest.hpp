@@ -0,0 +1,74 @@
+//
+//  DirtyRowsTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Drawing/DirtyRows.hpp"
+#include <vector>
+
+namespace DirtyRowsTest {
+
+using Span = std::pair<size_t, size_t>;
+
+template <size_t Height>
+std::vector<Span> spansOf(const DirtyRows<Height>& rows)
+{
+    std::vector<Span> spans;
+    rows.forEachSpan([&](size_t first, size_t count) { spans.emplace_back(first, count); });
+    return spans;
+}
+
+void spansAcrossWords(Test& t)
+{
+    DirtyRows<200> rows{};
+    t.expect(rows.any(), false);
+    t.expect(spansOf(rows).empty(), true);
+
+    rows.mark(0);
+    rows.mark(60, 10);
+    rows.mark(199);
+    rows.mark(200);
+    t.expect(rows.count(), size_t{12});
+    t.expect(spansOf(rows) == std::vector<Span>{{0, 1}, {60, 10}, {199, 1}}, true);
+}
+
+void markClipsToHeight(Test& t)
+{
+    DirtyRows<20> rows{};
+    rows.mark(16, 8);
+    t.expect(spansOf(rows) == std::vector<Span>{{16, 4}}, true);
+    rows.markAll();
+    t.expect(spansOf(rows) == std::vector<Span>{{0, 20}}, true);
+}
+
+void historyUnionSinceSeen(Test& t)
+{
+    DirtyRowsHistory<200, 4> history{};
+    t.expect(history.since(0).count(), size_t{200});
+
+    DirtyRows<200> rows{};
+    for (size_t frame = 1; frame <= 6; ++frame) {
+        rows.clear();
+        rows.mark(frame * 10);
+        history.push(rows);
+    }
+    t.expect(history.serial, uint64_t{6});
+    t.expect(history.since(6).any(), false);
+    t.expect(spansOf(history.since(5)) == std::vector<Span>{{60, 1}}, true);
+    t.expect(spansOf(history.since(3)) == std::vector<Span>{{40, 1}, {50, 1}, {60, 1}}, true);
+    // older than the history reaches back
+    t.expect(history.since(2).count(), size_t{200});
+    t.expect(history.since(7).count(), size_t{200});
+}
+
+void addAll(Test& t)
+{
+    t.add(spansAcrossWords);
+    t.add(markClipsToHeight);
+    t.add(historyUnionSinceSeen);
+}
+
+}
@@ -0,0 +1,200 @@
+//
+//  DrawListTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Drawing/DrawList.hpp"
+#include <array>
+#include <cstring>
+#include <memory>
+#include <random>
+
+namespace DrawListTest {
+
+using Atlas = Image<uint8_t, 16, 8>;
+using Screen = Image<uint8_t, 12, 10>;
+
+alignas(64) inline std::byte listMemory[4096];
+
+// page p is filled with 10 * (p + 1) plus its column, the top left pixel of each is transparent
+inline std::array<Atlas, 2> makePages() {
+    std::array<Atlas, 2> pages{};
+    for (int p = 0; p < 2; ++p) {
+        for (int y = 0; y < 8; ++y) {
+            for (int x = 0; x < 16; ++x) {
+                pages[p].at({x, y}) = static_cast<uint8_t>(10 * (p + 1) + x);
+            }
+        }
+        pages[p].at({0, 0}) = 0;
+    }
+    return pages;
+}
+
+void drawsInLayerThenPageOrder(Test& t)
+{
+    Arena arena{};
+    arena.init(listMemory, sizeof(listMemory));
+    const auto pages = makePages();
+    DrawList<Atlas> list{};
+    t.expect(list.init(arena, 16), true);
+
+    // all at the same spot, added in the opposite of the drawing order
+    list.add(1, 0, Vec2i{1, 0}, Vec2i{2, 2}, Vec2i{4, 4});
+    list.add(0, 1, Vec2i{2, 0}, Vec2i{3, 3}, Vec2i{4, 4});
+    list.add(0, 0, Vec2i{3, 0}, Vec2i{4, 4}, Vec2i{4, 4});
+    list.add(-1, 1, Vec2i{4, 0}, Vec2i{5, 5}, Vec2i{4, 4});
+    // same layer and page: the later one wins
+    list.add(2, 0, Vec2i{5, 0}, Vec2i{1, 1}, Vec2i{0, 0});
+    list.add(2, 0, Vec2i{6, 0}, Vec2i{1, 1}, Vec2i{0, 0});
+
+    Screen screen{};
+    list.execute(std::span<const Atlas>{pages}, screen);
+    t.expect(list.count, uint32_t{0});
+    t.expect(list.culledCount, uint32_t{0});
+    t.expect(screen.at({4, 4}), uint8_t{11});
+    t.expect(screen.at({6, 4}), uint8_t{24});
+    t.expect(screen.at({7, 4}), uint8_t{16});
+    t.expect(screen.at({8, 8}), uint8_t{28});
+    t.expect(screen.at({0, 0}), uint8_t{16});
+}
+
+void cullsAndClipsLikeTheImageFunctions(Test& t)
+{
+    Arena arena{};
+    arena.init(listMemory, sizeof(listMemory));
+    const auto pages = makePages();
+    DrawList<Atlas> list{};
+    list.init(arena, 16);
+
+    const Vec2i offScreen[] = { {-6, 0}, {12, 3}, {2, -5}, {0, 10} };
+    for (Vec2i position : offScreen) {
+        list.add(0, 0, Vec2i{0, 0}, Vec2i{6, 5}, position);
+    }
+    // a page the execute() is not given is dropped too
+    list.add(0, 7, Vec2i{0, 0}, Vec2i{6, 5}, Vec2i{1, 1});
+    list.add(0, 0, Vec2i{0, 0}, Vec2i{6, 5}, Vec2i{-3, 8});
+    list.addTransparent(1, 1, Vec2i{0, 0}, Vec2i{5, 4}, Vec2i{9, -2}, uint8_t{0});
+    // rectangles reaching out of their page are dropped instead of read past it
+    list.add(2, 0, Vec2i{12, 0}, Vec2i{6, 5}, Vec2i{1, 1});
+    list.addTransparent(2, 1, Vec2i{-1, 4}, Vec2i{3, 3}, Vec2i{1, 1}, uint8_t{0});
+    list.add(2, 1, Vec2i{0, 6}, Vec2i{2, 3}, Vec2i{1, 1});
+
+    Screen screen{};
+    list.execute(std::span<const Atlas>{pages}, screen);
+    t.expect(list.culledCount, uint32_t{8});
+
+    Screen expected{};
+    imageCopy(makeSubImage(pages[0], 0, 0, 6, 5), expected, Vec2i{-3, 8});
+    imageBlitWithTransparentColor(makeSubImage(pages[1], 0, 0, 5, 4), expected, Vec2i{9, -2}, uint8_t{0});
+    t.expect(std::memcmp(screen.data(), expected.data(), screen.bytesSize()), 0);
+}
+
+void takesRegionsAndKeepsCount(Test& t)
+{
+    Arena arena{};
+    arena.init(listMemory, sizeof(listMemory));
+    const auto pages = makePages();
+    DrawList<Atlas> list{};
+    list.init(arena, 2);
+
+    const auto region = makeSubImage(pages[1], 0, 0, 3, 2);
+    t.expect(list.addTransparent(0, 1, region, Vec2i{2, 2}, uint8_t{0}), true);
+    t.expect(list.add(0, 1, makeSubImage(pages[1], 5, 1, 2, 2), Vec2i{0, 0}), true);
+    t.expect(list.add(0, 0, Vec2i{}, Vec2i{1, 1}, Vec2i{}), false);
+    t.expect(list.overflowCount, uint32_t{1});
+
+    Screen screen{};
+    screen.fill(9);
+    list.execute(std::span<const Atlas>{pages}, screen);
+    t.expect(screen.at({2, 2}), uint8_t{9});
+    t.expect(screen.at({3, 2}), uint8_t{21});
+    t.expect(screen.at({4, 3}), uint8_t{22});
+    t.expect(screen.at({1, 1}), uint8_t{26});
+
+    // no room left for the commands
+    DrawList<Atlas> tooBig{};
+    t.expect(tooBig.init(arena, 1000), false);
+    t.expect(tooBig.add(0, 0, Vec2i{}, Vec2i{1, 1}, Vec2i{}), false);
+}
+
+// page, size and position of random draws, the same seed gives the same list
+inline void addRandomDraws(DrawList<Atlas>& list, uint32_t seed, int drawCount, Vec2i screenSize) {
+    std::mt19937 random{ seed };
+    for (int i = 0; i < drawCount; ++i) {
+        const Vec2i size{ 1 + static_cast<int>(random() % 16), 1 + static_cast<int>(random() % 8) };
+        const Vec2i source{ static_cast<int>(random() % (17 - size.x)), static_cast<int>(random() % (9 - size.y)) };
+        const Vec2i position{ static_cast<int>(random() % (screenSize.x + 40)) - 20, static_cast<int>(random() % (screenSize.y + 20)) - 10 };
+        const auto layer = static_cast<int16_t>(random() % 3);
+        const auto page = static_cast<uint16_t>(random() % 2);
+        if (random() % 2) {
+            list.add(layer, page, source, size, position);
+        } else {
+            list.addTransparent(layer, page, source, size, position, uint8_t{0});
+        }
+    }
+}
+
+void tilesDrawWhatTheSingleThreadDraws(Test& t)
+{
+    using VRAM = Image<uint8_t, 320, 200>;
+    constexpr size_t MemorySize = 1 << 18;
+    const auto memory = std::make_unique<std::byte[]>(MemorySize);
+    Arena arena{};
+    arena.init(memory.get(), MemorySize);
+    const auto pages = makePages();
+    WorkerPool workers;
+    workers.start(4);
+
+    const auto expectedImage = std::make_unique<VRAM>();
+    const auto actualImage = std::make_unique<VRAM>();
+    VRAM& expected = *expectedImage;
+    VRAM& actual = *actualImage;
+    for (uint32_t seed = 0; seed < 6; ++seed) {
+        DrawList<Atlas> list{};
+        list.init(arena, 2000);
+        addRandomDraws(list, seed, 1500, Vec2i{320, 200});
+        expected.fill(3);
+        list.execute(std::span<const Atlas>{pages}, expected);
+
+        addRandomDraws(list, seed, 1500, Vec2i{320, 200});
+        actual.fill(3);
+        const size_t used = arena.used;
+        if (seed % 2) {
+            list.executeTiled<32>(std::span<const Atlas>{pages}, actual, workers, arena);
+        } else {
+            list.executeTiled<7>(std::span<const Atlas>{pages}, actual, workers, arena);
+        }
+        t.expect(arena.used, used);
+        t.expect(list.count, uint32_t{0});
+        t.expect(std::memcmp(actual.data(), expected.data(), actual.bytesSize()), 0);
+        arena.reset();
+    }
+
+    // without room for the bins it still draws, on the caller
+    Arena tiny{};
+    tiny.init(memory.get(), 64);
+    DrawList<Atlas> list{};
+    list.commands = reinterpret_cast<DrawList<Atlas>::Command*>(memory.get() + 64);
+    list.capacity = 100;
+    addRandomDraws(list, 9, 100, Vec2i{320, 200});
+    actual.fill(3);
+    list.executeTiled(std::span<const Atlas>{pages}, actual, workers, tiny);
+    addRandomDraws(list, 9, 100, Vec2i{320, 200});
+    expected.fill(3);
+    list.execute(std::span<const Atlas>{pages}, expected);
+    t.expect(std::memcmp(actual.data(), expected.data(), actual.bytesSize()), 0);
+    t.expect(tiny.used, size_t{0});
+}
+
+void addAll(Test& t)
+{
+    t.add(drawsInLayerThenPageOrder);
+    t.add(cullsAndClipsLikeTheImageFunctions);
+    t.add(takesRegionsAndKeepsCount);
+    t.add(tilesDrawWhatTheSingleThreadDraws);
+}
+
+}
@@ -0,0 +1,88 @@
+//
+//  ImagesTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Drawing/Images.hpp"
+#include <memory>
+
+namespace ImagesTest {
+
+using Packed = Image<uint8_t, 5, 3>;
+using Pitched = Image<uint16_t, 5, 3, ImageOrigin::BottomLeft, 8>;
+
+void fillStaysInsideTheLines(Test& t)
+{
+    Pitched image{};
+    for (auto& line : image.lines) {
+        line.fill(0xEEEE);
+    }
+    image.fill(7);
+    for (auto& line : image.lines) {
+        for (size_t x = 0; x < 8; ++x) {
+            t.expect(line[x], uint16_t(x < 5 ? 7 : 0xEEEE));
+        }
+    }
+
+    Packed packed{};
+    packed.fill(3);
+    size_t count = 0;
+    packed.forEachPixel([&](const uint8_t& pixel) { count += pixel == 3; });
+    t.expect(count, Packed::VisiblePixelCount);
+}
+
+void forEachPixelVisitsInStorageOrder(Test& t)
+{
+    Pitched image{};
+    uint16_t next = 0;
+    image.forEachPixel([&](uint16_t& pixel) { pixel = next++; });
+    t.expect(next, uint16_t{15});
+    t.expect(image.at({4, 0}), uint16_t{4});
+    t.expect(image.at({0, 1}), uint16_t{5});
+    t.expect(image.at({4, 2}), uint16_t{14});
+    // the gap is not a pixel
+    t.expect(image.lines[0][5], uint16_t{0});
+
+    image.transformPixels([](uint16_t pixel) { return uint16_t(pixel * 2); });
+    t.expect(image.at({3, 2}), uint16_t{26});
+    const Pitched& constImage = image;
+    int sum = 0;
+    constImage.forEachPixel([&](const uint16_t& pixel) { sum += pixel; });
+    t.expect(sum, 2 * (14 * 15 / 2));
+}
+
+void copyKeepsTheLineOrder(Test& t)
+{
+    using TopDown = Image<uint8_t, 5, 3, ImageOrigin::TopLeft>;
+    Packed source{};
+    uint8_t next = 1;
+    source.transformPixels([&](uint8_t) { return next++; });
+
+    // the same layout, one copy
+    Packed same{};
+    imageCopy(source, same);
+    t.expect(std::memcmp(same.data(), source.data(), same.bytesSize()), 0);
+
+    // the other line order, line by line and flipped in memory
+    TopDown flipped{};
+    imageCopy(source, flipped);
+    t.expect(flipped.lines[0][0], source.lines[2][0]);
+    t.expect(flipped.lines[2][4], source.lines[0][4]);
+
+    // a narrower destination takes the start of every line
+    Image<uint8_t, 3, 2> narrow{};
+    imageCopy(source, narrow);
+    t.expect(narrow.at({2, 1}), source.at({2, 1}));
+}
+
+void addAll(Test& t)
+{
+    t.add(fillStaysInsideTheLines);
+    t.add(forEachPixelVisitsInStorageOrder);
+    t.add(copyKeepsTheLineOrder);
+}
+
+}
@@ -0,0 +1,150 @@
+//
+//  PaletteExpansionTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Drawing/PaletteExpansion.hpp"
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace PaletteExpansionTest {
+
+using namespace PaletteExpansion;
+
+std::unique_ptr<Tables> makeTables(size_t colorCount)
+{
+    auto tables = std::make_unique<Tables>();
+    std::mt19937 random{colorCount};
+    uint32_t palette[256];
+    for (uint32_t& color : palette) {
+        color = static_cast<uint32_t>(random());
+    }
+    tables->build(palette, colorCount);
+    return tables;
+}
+
+void kernelsAgreeWithThePalette(Test& t)
+{
+    for (size_t colorCount : {size_t{16}, size_t{256}}) {
+        auto tables = makeTables(colorCount);
+        std::mt19937 random{7};
+        // odd length and offset, so every kernel runs its tail and unaligned loads
+        std::vector<uint8_t> source(1001);
+        for (auto& index : source) {
+            index = static_cast<uint8_t>(random() % colorCount);
+        }
+        for (size_t k = 0; k < KernelCount; ++k) {
+            const auto kernel = static_cast<Kernel>(k);
+            if (!isUsable(kernel, *tables)) {
+                continue;
+            }
+            std::vector<uint32_t> destination(source.size(), 0);
+            expand(kernel, *tables, source.data() + 1, destination.data() + 1, source.size() - 1);
+            bool matches = destination[0] == 0;
+            for (size_t i = 1; i < source.size(); ++i) {
+                matches &= destination[i] == tables->palette[source[i]];
+            }
+            t.expect(matches, true);
+        }
+    }
+}
+
+void nibbleKernelNeedsSmallPalette(Test& t)
+{
+    auto tables = makeTables(256);
+    t.expect(isUsable(Kernel::Nibble_SSSE3, *tables), false);
+    t.expect(isUsable(Kernel::Scalar, *tables), true);
+    t.expect(isUsable(Kernel::PairLut, *tables), true);
+}
+
+void benchmarkPicksUsableKernel(Test& t)
+{
+    auto tables = makeTables(256);
+    std::vector<uint8_t> source(4096, 3);
+    std::vector<uint32_t> destination(source.size());
+    std::array<double, KernelCount> nsPerPixel;
+    const Kernel fastest = benchmark(*tables, source.data(), destination.data(), source.size(), 2, &nsPerPixel);
+    t.expect(isUsable(fastest, *tables), true);
+    t.expect(nsPerPixel[static_cast<size_t>(Kernel::Nibble_SSSE3)], 0.0);
+}
+
+void expanderUsesTheMeasuredKernels(Test& t)
+{
+    auto expander = std::make_unique<Expander>();
+    expander->measure(4096);
+    t.expect(isSupported(expander->smallPaletteKernel), true);
+    t.expect(isSupported(expander->fullPaletteKernel), true);
+    t.expect(expander->fullPaletteKernel != Kernel::Nibble_SSSE3, true);
+
+    auto tables = makeTables(256);
+    t.expect(expander->prepare(tables->palette.data(), 256), true);
+    t.expect(expander->prepare(tables->palette.data(), 256), false);
+    t.expect(expander->kernel == expander->fullPaletteKernel, true);
+    // the pair table is only worth building for the kernel that reads it
+    t.expect(expander->tables.hasPairs, expander->kernel == Kernel::PairLut);
+    t.expect(expander->prepare(tables->palette.data(), 16), true);
+    t.expect(expander->kernel == expander->smallPaletteKernel, true);
+
+    std::vector<uint8_t> source(333);
+    for (size_t i = 0; i < source.size(); ++i) {
+        source[i] = static_cast<uint8_t>(i % 16);
+    }
+    std::vector<uint32_t> destination(source.size());
+    (*expander)(source.data(), destination.data(), source.size());
+    bool matches = true;
+    for (size_t i = 0; i < source.size(); ++i) {
+        matches &= destination[i] == tables->palette[source[i]];
+    }
+    t.expect(matches, true);
+}
+
+void bandsExpandLikeOneCall(Test& t)
+{
+    auto expander = std::make_unique<Expander>();
+    auto tables = makeTables(256);
+    expander->prepare(tables->palette.data(), 256);
+    WorkerPool workers;
+    workers.start(4);
+
+    struct Size { size_t width, height, bands; };
+    // a full frame of the games and a bigger one split, a few rows stay on the caller
+    for (const Size size : {Size{320, 200, 3}, Size{640, 400, 4}, Size{320, 20, 1}}) {
+        const size_t count = size.width * size.height;
+        std::vector<uint8_t> source(count);
+        std::mt19937 random{static_cast<uint32_t>(count)};
+        for (auto& index : source) {
+            index = static_cast<uint8_t>(random());
+        }
+        std::vector<uint32_t> expected(count);
+        std::vector<uint32_t> actual(count);
+        (*expander)(source.data(), expected.data(), count);
+        t.expect(expander->expandRows(workers, source.data(), actual.data(), size.width, 0, size.height), size.bands);
+        t.expect(actual == expected, true);
+
+        // rows outside the span are left alone
+        std::fill(actual.begin(), actual.end(), 0u);
+        expander->expandRows(workers, source.data(), actual.data(), size.width, 1, size.height - 2);
+        bool onlyTheSpan = true;
+        for (size_t i = 0; i < count; ++i) {
+            const bool inside = i >= size.width && i < count - size.width;
+            onlyTheSpan &= actual[i] == (inside ? expected[i] : 0u);
+        }
+        t.expect(onlyTheSpan, true);
+    }
+}
+
+void addAll(Test& t)
+{
+    t.add(kernelsAgreeWithThePalette);
+    t.add(nibbleKernelNeedsSmallPalette);
+    t.add(benchmarkPicksUsableKernel);
+    t.add(expanderUsesTheMeasuredKernels);
+    t.add(bandsExpandLikeOneCall);
+}
+
+}
@@ -0,0 +1,102 @@
+//
+//  RunLengthSpriteTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Drawing/RunLengthSprite.hpp"
+#include <cstring>
+#include <random>
+
+namespace RunLengthSpriteTest {
+
+alignas(64) inline std::byte spriteMemory[4096];
+
+void compiledRunsSkipTransparency(Test& t)
+{
+    Arena arena{};
+    arena.init(spriteMemory, sizeof(spriteMemory));
+    const uint8_t pixels[] = {
+        0, 1, 1, 0, 0, 2,
+        0, 0, 0, 0, 0, 0,
+        3, 3, 3, 3, 3, 3,
+    };
+    const RunLengthSprite sprite = compileRunLengthSprite(arena, pixels, 6, 3, 6, 0);
+    t.expect(sprite.isValid(), true);
+    t.expect(sprite.runCount(), size_t{3});
+    t.expect(sprite.opaquePixelCount(), size_t{9});
+    t.expect(sprite.runs[0].skip, uint16_t{1});
+    t.expect(sprite.runs[0].length, uint16_t{2});
+    t.expect(sprite.runs[1].skip, uint16_t{2});
+    t.expect(sprite.runs[1].length, uint16_t{1});
+    // the empty row has no runs
+    t.expect(sprite.rows[1].firstRun, sprite.rows[2].firstRun);
+    t.expect(sprite.pixels[2], uint8_t{2});
+}
+
+void blitMatchesMaskedBlit(Test& t)
+{
+    Arena arena{};
+    arena.init(spriteMemory, sizeof(spriteMemory));
+    Image<uint8_t, 37, 11> picture{};
+    std::mt19937 random{ 22 };
+    picture.transformPixels([&](uint8_t) { return static_cast<uint8_t>(random() % 100 < 55 ? 0 : 1 + random() % 255); });
+    const RunLengthSprite sprite = compileRunLengthSprite(arena, picture, 0);
+    t.expect(sprite.isValid(), true);
+
+    for (int y = -12; y <= 25; y += 3) {
+        for (int x = -38; x <= 64; x += 7) {
+            Image<uint8_t, 60, 24> expected{};
+            Image<uint8_t, 60, 24> actual{};
+            expected.fill(0xEE);
+            actual.fill(0xEE);
+            imageBlitWithTransparentColor(picture, expected, Vec2i{x, y}, uint8_t{0});
+            blitRunLengthSprite(sprite, actual, Vec2i{x, y});
+            t.expect(std::memcmp(expected.data(), actual.data(), actual.bytesSize()), 0);
+        }
+    }
+}
+
+void pictureFramesCompileOnTheirOwn(Test& t)
+{
+    Arena arena{};
+    arena.init(spriteMemory, sizeof(spriteMemory));
+    SpritePicture<3, 2, 2> picture{ .data = {
+        1, 0, 1,  0, 2, 0,
+        0, 1, 0,  2, 2, 2,
+    } };
+    const RunLengthSprite second = compileRunLengthSprite(arena, picture, 1, 0);
+    t.expect(second.opaquePixelCount(), size_t{4});
+    Image<uint8_t, 3, 2> screen{};
+    blitRunLengthSprite(second, screen, Vec2i{});
+    t.expect(screen.at({1, 0}), uint8_t{2});
+    t.expect(screen.at({0, 0}), uint8_t{0});
+    t.expect(screen.at({0, 1}), uint8_t{2});
+}
+
+void fullArenaGivesInvalidSprite(Test& t)
+{
+    Arena arena{};
+    arena.init(spriteMemory, 64);
+    uint8_t pixels[64];
+    std::memset(pixels, 5, sizeof(pixels));
+    const RunLengthSprite sprite = compileRunLengthSprite(arena, pixels, 8, 8, 8, 0);
+    t.expect(sprite.isValid(), false);
+    t.expect(arena.used, size_t{0});
+    // and drawing it does nothing
+    Image<uint8_t, 8, 8> screen{};
+    blitRunLengthSprite(sprite, screen, Vec2i{});
+    t.expect(screen.at({3, 3}), uint8_t{0});
+}
+
+void addAll(Test& t)
+{
+    t.add(compiledRunsSkipTransparency);
+    t.add(blitMatchesMaskedBlit);
+    t.add(pictureFramesCompileOnTheirOwn);
+    t.add(fullArenaGivesInvalidSprite);
+}
+
+}
@@ -0,0 +1,83 @@
+//
+//  SpritesTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Drawing/Sprites.hpp"
+#include <vector>
+
+namespace SpritesTest {
+
+using Picture = SpritePicture<5, 3, 2>;
+constexpr int ScreenW = 12;
+constexpr int ScreenH = 8;
+
+constexpr Picture makePicture() {
+    Picture picture{};
+    for (int i = 0; i < static_cast<int>(picture.data.size()); ++i) {
+        picture.data[i] = static_cast<uint8_t>(i + 1);
+    }
+    return picture;
+}
+
+void blitSpriteClipsWholeRows(Test& t)
+{
+    const Picture picture = makePicture();
+    const Vec2i clipLower{ 1, 2 };
+    const Vec2i clipUpper{ 10, 7 };
+    for (int frame = 0; frame < Picture::frameCount; ++frame) {
+        for (int y = -4; y <= ScreenH; ++y) {
+            for (int x = -6; x <= ScreenW; ++x) {
+                std::vector<uint8_t> screen(ScreenW * ScreenH, 0xEE);
+                std::vector<uint8_t> expected(ScreenW * ScreenH, 0xEE);
+                blitSprite(picture, frame, screen.data(), ScreenW, Vec2i{x, y}, clipLower, clipUpper);
+                for (int sy = 0; sy < ScreenH; ++sy) {
+                    for (int sx = 0; sx < ScreenW; ++sx) {
+                        const Vec2i inFrame{ sx - x, sy - y };
+                        if (Vec2i{sx, sy} < clipUpper && clipLower <= Vec2i{sx, sy}
+                            && Vec2i{-1, -1} < inFrame && inFrame < Picture::frameSize) {
+                            expected[sx + sy * ScreenW] = picture.data[frame * 5 + inFrame.x + inFrame.y * Picture::pixelPitch];
+                        }
+                    }
+                }
+                t.expect(screen == expected, true);
+            }
+        }
+    }
+}
+
+void blitSpritesDrawsInSortedOrder(Test& t)
+{
+    const Picture picture = makePicture();
+    std::vector<SpriteInstance> instances{
+        { 1, Vec2i{ 4, 4 } },
+        { 0, Vec2i{ 6, 1 } },
+        { 1, Vec2i{ 5, 0 } },
+        { 0, Vec2i{ 0, 0 } },
+        { 0, Vec2i{ -2, 6 } },
+    };
+    std::vector<uint8_t> batched(ScreenW * ScreenH, 0);
+    blitSprites(picture, std::span{ instances }, batched.data(), ScreenW, Vec2i{}, Vec2i{ScreenW, ScreenH});
+
+    t.expect(instances[0].frameNumber, 0);
+    t.expect(instances[0].position.y, 0);
+    t.expect(instances[2].position.y, 6);
+    t.expect(instances[3].frameNumber, 1);
+
+    std::vector<uint8_t> oneByOne(ScreenW * ScreenH, 0);
+    for (const SpriteInstance& instance : instances) {
+        blitSprite(picture, instance.frameNumber, oneByOne.data(), ScreenW, instance.position, Vec2i{}, Vec2i{ScreenW, ScreenH});
+    }
+    t.expect(batched == oneByOne, true);
+}
+
+void addAll(Test& t)
+{
+    t.add(blitSpriteClipsWholeRows);
+    t.add(blitSpritesDrawsInSortedOrder);
+}
+
+}
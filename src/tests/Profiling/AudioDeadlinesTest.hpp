@@ -0,0 +1,142 @@
+//
+//  AudioDeadlinesTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Profiling/AudioDeadlines.hpp"
+#include "../../game/Profiling/Timings.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace AudioDeadlinesTest {
+
+using AudioDeadlines::Cause;
+
+// 1000 frames per second and 10 frames per buffer, so every buffer lasts 10 ms
+constexpr int64_t ms = 1'000'000;
+
+AudioDeadlines::Monitor makeMonitor()
+{
+    AudioDeadlines::Monitor monitor{};
+    monitor.start(100 * ms, 1000, 10, 3);
+    return monitor;
+}
+
+void deadlinesFollowTheSampleClock(Test& t)
+{
+    const auto monitor = makeMonitor();
+    t.expect(monitor.bufferDuration_ns(), 10 * ms);
+    t.expect(monitor.nearMiss_ns, 10 * ms);
+    t.expect(monitor.deadline_ns(0), 100 * ms);
+    t.expect(monitor.deadline_ns(50), 150 * ms);
+    // two buffers are still queued when this one is requested
+    t.expect(monitor.requested_ns(50), 130 * ms);
+}
+
+void deadlinesCountMissesAndUnderruns(Test& t)
+{
+    auto monitor = makeMonitor();
+    // requested at 130 ms, due at 150 ms
+    t.expect(monitor.record(50, 130 * ms, 131 * ms), 19 * ms);
+    t.expect(monitor.record(50, 130 * ms, 145 * ms), 5 * ms);
+    t.expect(monitor.record(50, 130 * ms, 152 * ms), -2 * ms);
+    t.expect(monitor.bufferCount, uint64_t{3});
+    t.expect(monitor.nearMissCount, uint64_t{1});
+    t.expect(monitor.underrunCount, uint64_t{1});
+    t.expect(monitor.worstMargin_ns, -2 * ms);
+    t.expect(monitor.worstSampleTime, 50.0);
+    t.expect(monitor.maxCompute_ns, 22 * ms);
+    t.expect(monitor.causeCount[static_cast<size_t>(Cause::Compute)], uint64_t{2});
+}
+
+void deadlinesBlameTheLargestPart(Test& t)
+{
+    auto monitor = makeMonitor();
+    // woke up 15 ms late, then computed for 6
+    monitor.record(50, 145 * ms, 151 * ms);
+    // on time, waited 12 ms for the lock and computed for 4
+    monitor.record(60, 140 * ms, 156 * ms, 12 * ms);
+    t.expect(monitor.underrunCount, uint64_t{1});
+    t.expect(monitor.nearMissCount, uint64_t{1});
+    t.expect(monitor.causeCount[static_cast<size_t>(Cause::Scheduling)], uint64_t{1});
+    t.expect(monitor.causeCount[static_cast<size_t>(Cause::Lock)], uint64_t{1});
+    t.expect(monitor.causeCount[static_cast<size_t>(Cause::Compute)], uint64_t{0});
+    t.expect(monitor.maxWakeLatency_ns, 15 * ms);
+    t.expect(monitor.maxLockWait_ns, 12 * ms);
+}
+
+void deadlinesMeasureLockWait(Test& t)
+{
+    std::mutex mutex;
+    {
+        auto lock = AudioDeadlines::lockMeasuringWait(mutex);
+        t.expect(lock.owns_lock(), true);
+        t.expect(AudioDeadlines::lastLockWait_ns.load(), int64_t{0});
+    }
+    std::unique_lock held(mutex);
+    std::atomic<bool> started{};
+    std::thread other([&] {
+        started.store(true);
+        auto lock = AudioDeadlines::lockMeasuringWait(mutex);
+    });
+    // a thread that only starts after the unlock would not wait at all
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    held.unlock();
+    other.join();
+    t.expect(AudioDeadlines::lastLockWait_ns.load() >= 4 * ms, true);
+}
+
+void deadlinesPrint(Test& t)
+{
+    auto monitor = makeMonitor();
+    monitor.record(50, 130 * ms, 152 * ms);
+    char buffer[512]{};
+    const int written = monitor.print(buffer, sizeof(buffer));
+    const std::string text = buffer;
+    t.expect(written, static_cast<int>(text.size()));
+    t.expect(text.find("1 buffers, 1 underruns, 0 near misses") != std::string::npos, true);
+    t.expect(text.find("worst -2.00 ms") != std::string::npos, true);
+
+    char small[16]{};
+    t.expect(monitor.print(small, sizeof(small)), 15);
+    t.expect(monitor.print(buffer, sizeof(buffer), "simulated audio deadlines") > written, true);
+    t.expect(std::string(buffer).starts_with("simulated audio deadlines: 1 buffers"), true);
+}
+
+void deadlinesThroughTheCInterface(Test& t)
+{
+    char buffer[512]{'x'};
+    // nothing recorded yet
+    t.expect(profiling_audio_print(buffer, sizeof(buffer)), 0);
+    t.expect(buffer[0], '\0');
+
+    // the buffer at sample 0 is due at 0 ns, this call ends 10 ms before, within one buffer's duration
+    profiling_audio_start(0, AudioFramesPerSecond);
+    profiling_audio_record(0, -50 * ms, -10 * ms, 0);
+    std::thread printer([&] {
+        profiling_audio_print(buffer, sizeof(buffer));
+    });
+    printer.join();
+    t.expect(std::string(buffer).starts_with("audio deadlines: 1 buffers, 0 underruns, 1 near misses"), true);
+    t.expect(profiling_audio_now_ns() > 0, true);
+}
+
+void addAll(Test& t)
+{
+    t.add(deadlinesFollowTheSampleClock);
+    t.add(deadlinesCountMissesAndUnderruns);
+    t.add(deadlinesBlameTheLargestPart);
+    t.add(deadlinesMeasureLockWait);
+    t.add(deadlinesPrint);
+    t.add(deadlinesThroughTheCInterface);
+}
+
+}
@@ -0,0 +1,196 @@
+//
+//  MemoryReportTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Profiling/MemoryReport.hpp"
+#include <string>
+
+namespace MemoryReportTest {
+
+struct SampleLayout {
+    char tickFlag;
+    alignas(8) double audioValue;
+    char lines[100];
+    alignas(64) int drawCounter;
+};
+
+void describeSample(const SampleLayout& layout, MemoryReport::Report<>& report)
+{
+    using namespace MemoryReport;
+    report.begin(layout, 1);
+    // out of order on purpose
+    report.add("drawCounter", layout, layout.drawCounter, DrawThread);
+    report.add("tickFlag", layout, layout.tickFlag, TickThread);
+    report.add("audioValue", layout, layout.audioValue, AudioThread);
+    report.add("lines", layout, layout.lines, TickThread);
+    report.end();
+}
+
+void memoryReportListsMembersInOrder(Test& t)
+{
+    SampleLayout layout{};
+    MemoryReport::Report<> report{};
+    describeSample(layout, report);
+    t.expect(report.memberCount, size_t{4});
+    t.expect(report.layoutSize, sizeof(SampleLayout));
+    t.expect(std::string(report.members[0].name), std::string("tickFlag"));
+    t.expect(std::string(report.members[3].name), std::string("drawCounter"));
+    t.expect(report.members[1].offset, size_t{8});
+    t.expect(report.members[1].alignment, size_t{8});
+    t.expect(report.members[3].offset, size_t{128});
+    t.expect(report.members[2].size, size_t{100});
+}
+
+void memoryReportCountsPadding(Test& t)
+{
+    SampleLayout layout{};
+    MemoryReport::Report<> report{};
+    describeSample(layout, report);
+    t.expect(report.paddingBefore(0), size_t{0});
+    t.expect(report.paddingBefore(1), size_t{7});
+    // lines end at 116, drawCounter starts on the next cache line
+    t.expect(report.paddingBefore(3), size_t{12});
+    t.expect(report.trailingPadding(), sizeof(SampleLayout) - 132);
+    t.expect(report.totalPadding(), size_t{7 + 12} + sizeof(SampleLayout) - 132);
+}
+
+void memoryReportFindsSharedLines(Test& t)
+{
+    SampleLayout layout{};
+    MemoryReport::Report<> report{};
+    describeSample(layout, report);
+    // tickFlag, audioValue and the start of lines are all on line 0
+    t.expect(report.sharesLineWith(0) == &report.members[1], true);
+    t.expect(report.sharesLineWith(1) != nullptr, true);
+    // drawCounter has its line to itself
+    t.expect(report.sharesLineWith(3) == nullptr, true);
+    t.expect(report.firstLine(report.members[2]), size_t{0});
+    t.expect(report.lastLine(report.members[2]), size_t{1});
+}
+
+struct MovedLayout {
+    char tickFlag;
+    alignas(8) double audioValue;
+    char lines[104];
+    alignas(64) int drawCounter;
+};
+
+void memoryReportHashFollowsLayout(Test& t)
+{
+    SampleLayout layout{};
+    MemoryReport::Report<> report{};
+    describeSample(layout, report);
+    MemoryReport::Report<> again{};
+    describeSample(layout, again);
+    t.expect(report.hash(), again.hash());
+
+    // lines grew, nothing else moved
+    MovedLayout moved{};
+    MemoryReport::Report<> movedReport{};
+    movedReport.begin(moved, 1);
+    movedReport.add("drawCounter", moved, moved.drawCounter, MemoryReport::DrawThread);
+    movedReport.add("tickFlag", moved, moved.tickFlag, MemoryReport::TickThread);
+    movedReport.add("audioValue", moved, moved.audioValue, MemoryReport::AudioThread);
+    movedReport.add("lines", moved, moved.lines, MemoryReport::TickThread);
+    movedReport.end();
+    t.expect(movedReport.layoutSize, report.layoutSize);
+    t.expect(movedReport.hash() != report.hash(), true);
+
+    // and a renamed member is a different layout too
+    again.members[0].name = "tickFlags";
+    t.expect(again.hash() != report.hash(), true);
+}
+
+struct Pair {
+    uint32_t first;
+    uint64_t second;
+};
+
+// the same members as Pair in the other order, same size and alignment
+struct SwappedPair {
+    uint64_t second;
+    uint32_t first;
+};
+
+template <typename Inner>
+struct NestedLayout {
+    int counter;
+    Inner inner;
+};
+
+template <typename Inner>
+uint64_t hashNested(uint32_t version)
+{
+    NestedLayout<Inner> layout{};
+    MemoryReport::Report<> report{};
+    report.begin(layout, version);
+    report.add("counter", layout, layout.counter, MemoryReport::TickThread);
+    report.add("inner", layout, layout.inner, MemoryReport::TickThread);
+    report.end();
+    return report.hash();
+}
+
+void memoryReportHashSeesInsideMembers(Test& t)
+{
+    static_assert(sizeof(Pair) == sizeof(SwappedPair) && alignof(Pair) == alignof(SwappedPair));
+    t.expect(hashNested<Pair>(1), hashNested<Pair>(1));
+    // a member's type reordered inside, nothing about its placement changed
+    t.expect(hashNested<Pair>(1) != hashNested<SwappedPair>(1), true);
+    // what the type's name does not tell, the version has to
+    t.expect(hashNested<Pair>(1) != hashNested<Pair>(2), true);
+
+    static_assert(MemoryReport::coversLayout(&NestedLayout<Pair>::counter, &NestedLayout<Pair>::inner));
+    // lines left out
+    static_assert(!MemoryReport::coversLayout(&MovedLayout::tickFlag, &MovedLayout::audioValue, &MovedLayout::drawCounter));
+}
+
+void memoryReportFindsUndescribedBytes(Test& t)
+{
+    SampleLayout layout{};
+    MemoryReport::Report<> report{};
+    describeSample(layout, report);
+    // all of the padding is what the alignment asks for
+    t.expect(report.undescribedBytes(), size_t{0});
+
+    // without lines there is a gap no alignment explains, drawCounter might be aligned to 64 and
+    // lines is 112 bytes, so 64 of them are certain
+    report.begin(layout, 1);
+    report.add("tickFlag", layout, layout.tickFlag, MemoryReport::TickThread);
+    report.add("audioValue", layout, layout.audioValue, MemoryReport::AudioThread);
+    report.add("drawCounter", layout, layout.drawCounter, MemoryReport::DrawThread);
+    report.end();
+    t.expect(report.undescribedBytes(), size_t{64});
+}
+
+void memoryReportPrints(Test& t)
+{
+    SampleLayout layout{};
+    MemoryReport::Report<> report{};
+    describeSample(layout, report);
+    char buffer[2048]{};
+    const int written = report.print(buffer, sizeof(buffer));
+    const std::string text = buffer;
+    t.expect(written, static_cast<int>(text.size()));
+    t.expect(text.find("T--     tickFlag  shares a line with audioValue") != std::string::npos, true);
+    t.expect(text.find("-D-     drawCounter\n") != std::string::npos, true);
+
+    char small[32]{};
+    t.expect(report.print(small, sizeof(small)), 31);
+}
+
+void addAll(Test& t)
+{
+    t.add(memoryReportListsMembersInOrder);
+    t.add(memoryReportCountsPadding);
+    t.add(memoryReportFindsSharedLines);
+    t.add(memoryReportHashFollowsLayout);
+    t.add(memoryReportHashSeesInsideMembers);
+    t.add(memoryReportFindsUndescribedBytes);
+    t.add(memoryReportPrints);
+}
+
+}
@@ -0,0 +1,210 @@
+//
+//  TimingsTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Profiling/Timings.h"
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace TimingsTest {
+
+// every call advances the clock by one microsecond
+inline std::atomic<int64_t> fakeNow{};
+inline int64_t fakeTime() { return fakeNow.fetch_add(1, std::memory_order_relaxed); }
+
+void intervalsFromManyThreads(Test& t)
+{
+    TimingData data{ .getPlatformTimeMicroseconds = fakeTime };
+    constexpr int ThreadCount = 4;
+    constexpr int Samples = 20'000;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < ThreadCount; ++i) {
+        threads.emplace_back([&data, i] {
+            // each thread has its own timer, but they all report into the same interval
+            const auto timer = static_cast<TimingTimer>(i);
+            profiling_time_set(&data, timer);
+            for (int sample = 0; sample < Samples; ++sample) {
+                profiling_time_interval(&data, timer, eTimingTickDo);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    t.expect(data.intervalCount[eTimingTickDo], ThreadCount * Samples);
+    t.expect(data.intervals[eTimingTickDo] >= ThreadCount * Samples, true);
+
+    profiling_time_clear(&data);
+    t.expect(data.intervalCount[eTimingTickDo], 0);
+    t.expect(data.intervals[eTimingTickDo], int64_t{0});
+}
+
+// a clock that returns whatever the test sets next
+inline int64_t scriptedNow = 0;
+inline int64_t scriptedTime() { return scriptedNow; }
+
+void recordInterval(TimingData& data, int64_t microseconds)
+{
+    scriptedNow = 0;
+    profiling_time_set(&data, eTimerBufferCopy);
+    scriptedNow = microseconds;
+    profiling_time_interval(&data, eTimerBufferCopy, eTimingBufferCopy);
+}
+
+void percentilesFromHistogram(Test& t)
+{
+    auto data = std::make_unique<TimingData>();
+    data->getPlatformTimeMicroseconds = scriptedTime;
+    t.expect(profiling_time_percentile(data.get(), eTimingBufferCopy, 50), int64_t{0});
+
+    // 1..1000 us, one each
+    for (int64_t us = 1; us <= 1000; ++us) {
+        recordInterval(*data, us);
+    }
+    t.expect(profiling_time_percentile(data.get(), eTimingBufferCopy, 0), int64_t{1});
+    t.expect(profiling_time_percentile(data.get(), eTimingBufferCopy, 100), int64_t{1000});
+    // buckets are at most 12.5% wide and report their upper edge
+    const int64_t p50 = profiling_time_percentile(data.get(), eTimingBufferCopy, 50);
+    const int64_t p99 = profiling_time_percentile(data.get(), eTimingBufferCopy, 99);
+    t.expect(p50 >= 500 && p50 <= 500 * 9 / 8, true);
+    t.expect(p99 >= 990 && p99 <= 1000, true);
+    // small values are exact
+    profiling_time_clear(data.get());
+    recordInterval(*data, 3);
+    recordInterval(*data, 5);
+    t.expect(profiling_time_percentile(data.get(), eTimingBufferCopy, 50), int64_t{3});
+    t.expect(profiling_time_percentile(data.get(), eTimingBufferCopy, 99.9), int64_t{5});
+}
+
+void spikeShowsInTail(Test& t)
+{
+    auto data = std::make_unique<TimingData>();
+    data->getPlatformTimeMicroseconds = scriptedTime;
+    for (int i = 0; i < 999; ++i) {
+        recordInterval(*data, 100);
+    }
+    recordInterval(*data, 40'000);
+    t.expect(profiling_time_percentile(data.get(), eTimingBufferCopy, 99), int64_t{103});
+    t.expect(profiling_time_percentile(data.get(), eTimingBufferCopy, 99.95), int64_t{40'000});
+}
+
+void backwardsClockRecordsZero(Test& t)
+{
+    auto data = std::make_unique<TimingData>();
+    data->getPlatformTimeMicroseconds = scriptedTime;
+    recordInterval(*data, 10);
+    recordInterval(*data, -500);
+    t.expect(data->intervals[eTimingBufferCopy], int64_t{10});
+    t.expect(data->intervalCount[eTimingBufferCopy], 2);
+    t.expect(profiling_time_percentile(data.get(), eTimingBufferCopy, 0), int64_t{0});
+    t.expect(profiling_time_percentile(data.get(), eTimingBufferCopy, 100), int64_t{10});
+}
+
+void printShowsMean(Test& t)
+{
+    auto data = std::make_unique<TimingData>();
+    data->getPlatformTimeMicroseconds = scriptedTime;
+    recordInterval(*data, 50);
+    recordInterval(*data, 100);
+    recordInterval(*data, 150);
+    char buffer[TimingPrintBufferSize];
+    profiling_time_print(data.get(), buffer, sizeof(buffer));
+    t.expect(std::string_view(buffer).find("BufferCopy              3     100      50") != std::string_view::npos, true);
+
+    // a short buffer is cut off but stays terminated
+    char small[40];
+    t.expect(profiling_time_print(data.get(), small, sizeof(small)), int(sizeof(small)) - 1);
+    t.expect(std::string_view(small).size(), sizeof(small) - 1);
+}
+
+void traceHasEveryThread(Test& t)
+{
+    TimingData data{ .getPlatformTimeMicroseconds = fakeTime };
+    profiling_trace_clear();
+    auto work = [&data](const char* name, TimingInterval interval) {
+        profiling_trace_name_thread(name);
+        profiling_time_set(&data, eTimerTick);
+        for (int i = 0; i < 100; ++i) {
+            profiling_time_interval(&data, eTimerTick, interval);
+        }
+    };
+    std::thread audio(work, "audio", eTimingFillAudioBuffer);
+    audio.join();
+    std::thread tick(work, "tick", eTimingTickDo);
+    tick.join();
+    std::thread quoted(work, "\"q\\\n", eTimingTickDo);
+    quoted.join();
+
+    const char* filename = "TimingsTest_trace.json";
+    t.expect(profiling_trace_write_json(filename), 300);
+
+    std::string json;
+    if (FILE* file = std::fopen(filename, "r")) {
+        char chunk[4096];
+        for (size_t read; (read = std::fread(chunk, 1, sizeof(chunk), file)) > 0;) {
+            json.append(chunk, read);
+        }
+        std::fclose(file);
+    }
+    std::remove(filename);
+    t.expect(json.find("\"args\":{\"name\":\"audio\"}") != std::string::npos, true);
+    t.expect(json.find("\"args\":{\"name\":\"tick\"}") != std::string::npos, true);
+    t.expect(json.find("\"args\":{\"name\":\"\\\"q\\\\\\u000a\"}") != std::string::npos, true);
+    t.expect(json.find("\"name\":\"AudioBufFill\",\"ph\":\"X\"") != std::string::npos, true);
+    t.expect(json.find("\"name\":\"TickDo\",\"ph\":\"X\"") != std::string::npos, true);
+    t.expect(json.substr(json.size() - 4), std::string("\n]}\n"));
+}
+
+void traceKeepsNewestEvents(Test& t)
+{
+    TimingData data{ .getPlatformTimeMicroseconds = fakeTime };
+    profiling_trace_clear();
+    profiling_time_set(&data, eTimerDraw);
+    for (int i = 0; i < TimingTraceCapacity + 10; ++i) {
+        profiling_time_interval(&data, eTimerDraw, eTimingDrawEncoding);
+    }
+    profiling_trace_set_enabled(0);
+    profiling_time_interval(&data, eTimerDraw, eTimingDrawEncoding);
+    profiling_trace_set_enabled(1);
+
+    const char* filename = "TimingsTest_trace.json";
+    t.expect(profiling_trace_write_json(filename), int{TimingTraceCapacity});
+    std::remove(filename);
+    profiling_trace_clear();
+}
+
+void traceFailsOnFullDisk(Test& t)
+{
+#ifdef __linux__
+    // opening /dev/full works, the writes fail with ENOSPC at the latest when fclose flushes them
+    TimingData data{ .getPlatformTimeMicroseconds = fakeTime };
+    profiling_trace_clear();
+    profiling_time_set(&data, eTimerDraw);
+    for (int i = 0; i < 10; ++i) {
+        profiling_time_interval(&data, eTimerDraw, eTimingDrawEncoding);
+    }
+    t.expect(profiling_trace_write_json("/dev/full"), -1);
+    profiling_trace_clear();
+#endif
+}
+
+void addAll(Test& t)
+{
+    t.add(intervalsFromManyThreads);
+    t.add(percentilesFromHistogram);
+    t.add(spikeShowsInTail);
+    t.add(backwardsClockRecordsZero);
+    t.add(printShowsMean);
+    t.add(traceHasEveryThread);
+    t.add(traceKeepsNewestEvents);
+    t.add(traceFailsOnFullDisk);
+}
+
+}
@@ -0,0 +1,163 @@
+//
+//  ZonesTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Profiling/Zones.hpp"
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace ZonesTest {
+
+#if PROFILING_ZONES
+
+// the registry is shared by the whole process, so every test uses zone names of its own
+inline uint32_t findZone(const char* name)
+{
+    auto& reg = ProfilingZones::registry();
+    for (uint32_t id = 0; id < reg.zoneCount.load(); ++id) {
+        const char* zoneName = reg.zones[id].name.load();
+        if (zoneName && std::strcmp(zoneName, name) == 0)
+            return id;
+    }
+    return ProfilingZones::NoZone;
+}
+
+inline void spin(uint64_t ns)
+{
+    const uint64_t end = ProfilingZones::now_ns() + ns;
+    while (ProfilingZones::now_ns() < end) {}
+}
+
+inline void leaf()
+{
+    PROFILE_ZONE("ZonesTest leaf");
+    spin(20'000);
+}
+
+inline void branch()
+{
+    PROFILE_ZONE("ZonesTest branch");
+    leaf();
+    leaf();
+}
+
+void zonesNest(Test& t)
+{
+    {
+        PROFILE_ZONE("ZonesTest root");
+        branch();
+    }
+    const uint32_t root = findZone("ZonesTest root");
+    const uint32_t inner = findZone("ZonesTest branch");
+    const uint32_t innermost = findZone("ZonesTest leaf");
+    auto& zones = ProfilingZones::registry().zones;
+    t.expect(zones[root].parent.load(), ProfilingZones::NoZone);
+    t.expect(zones[inner].parent.load(), root);
+    t.expect(zones[innermost].parent.load(), inner);
+
+    // a zone keeps the place of its first run
+    leaf();
+    t.expect(zones[innermost].parent.load(), inner);
+}
+
+void zonesAggregatePerFrame(Test& t)
+{
+    ProfilingZones::endFrame();
+    ProfilingZones::clear();
+    for (int frame = 0; frame < 3; ++frame) {
+        branch();
+        ProfilingZones::endFrame();
+    }
+    auto& zones = ProfilingZones::registry().zones;
+    const auto& inner = zones[findZone("ZonesTest branch")];
+    const auto& innermost = zones[findZone("ZonesTest leaf")];
+    t.expect(ProfilingZones::registry().frameCount.load(), uint64_t{3});
+    t.expect(inner.totalCalls.load(), uint64_t{3});
+    t.expect(innermost.totalCalls.load(), uint64_t{6});
+    t.expect(inner.frameCalls.load(), uint64_t{0});
+
+    // the branch spends its time in the leaves, which do not count as its own
+    t.expect(inner.totalInclusive_ns.load() >= 6 * 20'000, true);
+    t.expect(inner.totalChildren_ns.load() >= 6 * 20'000, true);
+    t.expect(inner.totalChildren_ns.load() <= inner.totalInclusive_ns.load(), true);
+    t.expect(innermost.totalChildren_ns.load(), uint64_t{0});
+    t.expect(inner.maxFrameInclusive_ns.load() >= 2 * 20'000, true);
+}
+
+void zonesFromOtherThreads(Test& t)
+{
+    std::thread([] {
+        PROFILE_ZONE("ZonesTest thread");
+        leaf();
+    }).join();
+    // the thread's zone is a root of its own, the leaf still sits where it first ran
+    const uint32_t threadZone = findZone("ZonesTest thread");
+    auto& zones = ProfilingZones::registry().zones;
+    t.expect(zones[threadZone].parent.load(), ProfilingZones::NoZone);
+    t.expect(zones[findZone("ZonesTest leaf")].parent.load(), findZone("ZonesTest branch"));
+    t.expect(ProfilingZones::currentScope == nullptr, true);
+}
+
+inline void printLeaf()
+{
+    PROFILE_ZONE("ZonesTest print leaf");
+}
+
+inline void printBranch()
+{
+    PROFILE_ZONE("ZonesTest print branch");
+    printLeaf();
+}
+
+void zonesPrintAsTree(Test& t)
+{
+    // zones of its own, so their places in the tree do not depend on the other tests
+    ProfilingZones::clear();
+    {
+        PROFILE_ZONE("ZonesTest print root");
+        printBranch();
+    }
+    ProfilingZones::endFrame();
+
+    char buffer[4096]{};
+    const int written = ProfilingZones::print(buffer, sizeof(buffer));
+    const std::string text = buffer;
+    t.expect(written, static_cast<int>(text.size()));
+    t.expect(text.find("zone") == 0, true);
+    const auto rootLine = text.find("\nZonesTest print root ");
+    const auto branchLine = text.find("\n  ZonesTest print branch ");
+    const auto leafLine = text.find("\n    ZonesTest print leaf ");
+    t.expect(rootLine != std::string::npos, true);
+    t.expect(branchLine != std::string::npos, true);
+    t.expect(leafLine != std::string::npos, true);
+    t.expect(rootLine < branchLine && branchLine < leafLine, true);
+
+    // cut short without running past the end
+    char small[40];
+    std::memset(small, 'x', sizeof(small));
+    const int truncated = ProfilingZones::print(small, 20);
+    t.expect(truncated, 19);
+    t.expect(std::strlen(small), size_t{19});
+    t.expect(small[20], 'x');
+}
+
+#endif
+
+void addAll(Test& t)
+{
+#if PROFILING_ZONES
+    t.add(zonesNest);
+    t.add(zonesAggregatePerFrame);
+    t.add(zonesFromOtherThreads);
+    t.add(zonesPrintAsTree);
+#else
+    (void)t;
+#endif
+}
+
+}
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <functional>
 #include <iostream>
 #include <sstream>
 #include <vector>
@@ -9,10 +9,44 @@
 
 #include "Math/TrigonometryTest.hpp"
 #include "Math/FixedPointTest.hpp"
+#include "Drawing/BlitTest.hpp"
+#include "Drawing/DirtyRowsTest.hpp"
+#include "Drawing/DrawListTest.hpp"
+#include "Drawing/ImagesTest.hpp"
+#include "Drawing/PaletteExpansionTest.hpp"
+#include "Drawing/RunLengthSpriteTest.hpp"
+#include "Drawing/SpritesTest.hpp"
+#include "Profiling/AudioDeadlinesTest.hpp"
+#include "Profiling/MemoryReportTest.hpp"
+#include "Profiling/TimingsTest.hpp"
+#include "Profiling/ZonesTest.hpp"
+#include "Utility/ABunchOfTest.hpp"
+#include "Utility/ArenaTest.hpp"
+#include "Utility/InputRecordingTest.hpp"
+#include "Utility/RewindTest.hpp"
+#include "Utility/TripleBufferTest.hpp"
+#include "Utility/WorkerPoolTest.hpp"
 
 int main() {
     Test t{};
     t.add(test_myCos);
     FixedPointTest::addAll(t);
+    BlitTest::addAll(t);
+    DirtyRowsTest::addAll(t);
+    DrawListTest::addAll(t);
+    ImagesTest::addAll(t);
+    PaletteExpansionTest::addAll(t);
+    RunLengthSpriteTest::addAll(t);
+    SpritesTest::addAll(t);
+    AudioDeadlinesTest::addAll(t);
+    MemoryReportTest::addAll(t);
+    TimingsTest::addAll(t);
+    ZonesTest::addAll(t);
+    ABunchOfTest::addAll(t);
+    ArenaTest::addAll(t);
+    InputRecordingTest::addAll(t);
+    RewindTest::addAll(t);
+    TripleBufferTest::addAll(t);
+    WorkerPoolTest::addAll(t);
     return t.run();
 }
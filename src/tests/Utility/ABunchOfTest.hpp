@@ -0,0 +1,103 @@
+//
+//  ABunchOfTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Utility/ABunchOf.hpp"
+#include <vector>
+
+namespace ABunchOfTest {
+
+void freeListReusesSlots(Test& t)
+{
+    ABunchOf<int, 4> bunch{};
+    const size_t a = bunch.insert(1);
+    const size_t b = bunch.insert(2);
+    bunch.free(a);
+    t.expect(bunch.size(), size_t{1});
+    t.expect(bunch.insert(3), a);
+    t.expect(bunch[b], 2);
+    t.expect(bunch[a], 3);
+}
+
+void packedIteratesLiveElements(Test& t)
+{
+    APackedBunchOf<int, 8> bunch{};
+    BunchHandle handles[5];
+    for (int i = 0; i < 5; ++i) {
+        handles[i] = bunch.insert(i * 10);
+    }
+    t.expect(bunch.free(handles[1]), true);
+    t.expect(bunch.free(handles[3]), true);
+    t.expect(bunch.size(), size_t{3});
+
+    int sum = 0;
+    size_t visited = 0;
+    for (int value : bunch) {
+        sum += value;
+        ++visited;
+    }
+    t.expect(visited, size_t{3});
+    t.expect(sum, 0 + 20 + 40);
+    for (size_t i = 0; i < bunch.size(); ++i) {
+        t.expect(&bunch[bunch.handleAt(i)], &*(bunch.begin() + i));
+    }
+    t.expect(bunch[handles[4]], 40);
+}
+
+void staleHandlesAreRejected(Test& t)
+{
+    APackedBunchOf<int, 2> bunch{};
+    const BunchHandle first = bunch.insert(1);
+    t.expect(bunch.contains(first), true);
+    t.expect(bunch.contains(BunchHandle{}), false);
+    t.expect(bunch.free(first), true);
+    t.expect(bunch.free(first), false);
+    t.expect(bunch.get(first) == nullptr, true);
+
+    // the same slot again, under a new generation
+    const BunchHandle second = bunch.insert(2);
+    t.expect(second.slot, first.slot);
+    t.expect(second.generation != first.generation, true);
+    t.expect(bunch.contains(first), false);
+    t.expect(*bunch.get(second), 2);
+
+    bunch.reset();
+    t.expect(bunch.contains(second), false);
+    t.expect(bunch.empty(), true);
+}
+
+void freeingWhileWalkingBackwards(Test& t)
+{
+    APackedBunchOf<int, 64> bunch{};
+    std::vector<BunchHandle> handles;
+    for (int i = 0; i < 64; ++i) {
+        handles.push_back(bunch.insert(int(i)));
+    }
+    for (size_t i = bunch.size(); i-- > 0;) {
+        if (bunch.begin()[i] % 3 == 0) {
+            bunch.free(bunch.handleAt(i));
+        }
+    }
+    t.expect(bunch.size(), size_t{42});
+    for (int i = 0; i < 64; ++i) {
+        const int* value = bunch.get(handles[i]);
+        t.expect(value == nullptr, i % 3 == 0);
+        if (value) {
+            t.expect(*value, i);
+        }
+    }
+}
+
+void addAll(Test& t)
+{
+    t.add(freeListReusesSlots);
+    t.add(packedIteratesLiveElements);
+    t.add(staleHandlesAreRejected);
+    t.add(freeingWhileWalkingBackwards);
+}
+
+}
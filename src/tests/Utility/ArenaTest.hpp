@@ -0,0 +1,120 @@
+//
+//  ArenaTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Utility/Arena.hpp"
+#include <cstring>
+
+namespace ArenaTest {
+
+alignas(64) inline std::byte arenaMemory[1024];
+
+void arenaAligns(Test& t)
+{
+    Arena arena{};
+    arena.init(arenaMemory, sizeof(arenaMemory));
+    t.expect(arena.isInitialized(), true);
+    auto* first = arena.allocateArray<uint8_t>(3);
+    t.expect(reinterpret_cast<std::byte*>(first), &arenaMemory[0]);
+    auto* second = arena.allocateArray<uint32_t>(2);
+    t.expect(reinterpret_cast<std::byte*>(second), &arenaMemory[4]);
+    auto* third = arena.allocate(10, 64);
+    t.expect(static_cast<std::byte*>(third), &arenaMemory[64]);
+    t.expect(arena.used, size_t{74});
+}
+
+void arenaRunsOut(Test& t)
+{
+    Arena arena{};
+    arena.init(arenaMemory, sizeof(arenaMemory));
+    t.expect(arena.allocate(1000, 1) != nullptr, true);
+    t.expect(arena.allocate(25, 1) == nullptr, true);
+    // the padding alone does not fit either
+    t.expect(arena.allocate(0, 1024) == nullptr, true);
+    t.expect(arena.allocate(24, 1) != nullptr, true);
+    t.expect(arena.remaining(), size_t{0});
+    t.expect(arena.allocateArray<uint64_t>(SIZE_MAX / 4) == nullptr, true);
+}
+
+void arenaRewindsAndKeepsHighWater(Test& t)
+{
+    Arena arena{};
+    arena.init(arenaMemory, sizeof(arenaMemory));
+    arena.allocate(100, 1);
+    {
+        ArenaScope temporary(arena);
+        arena.allocate(300, 1);
+        t.expect(arena.used, size_t{400});
+    }
+    t.expect(arena.used, size_t{100});
+    t.expect(arena.highWater, size_t{400});
+    arena.reset();
+    t.expect(arena.used, size_t{0});
+    t.expect(arena.highWater, size_t{400});
+    // rewinding forward does nothing
+    arena.rewind(500);
+    t.expect(arena.used, size_t{0});
+}
+
+void arenaKeepsWhatWasWrittenToTop(Test& t)
+{
+    Arena arena{};
+    arena.init(arenaMemory, sizeof(arenaMemory));
+    arena.allocate(8, 1);
+    const char text[] = "loaded";
+    std::memcpy(arena.top(), text, sizeof(text));
+    auto* kept = arena.allocateArray<char>(sizeof(text), 1);
+    t.expect(std::strcmp(kept, "loaded"), 0);
+    t.expect(arena.used, size_t{8} + sizeof(text));
+}
+
+void arenaCarvesSubArenas(Test& t)
+{
+    Arena arena{};
+    arena.init(arenaMemory, sizeof(arenaMemory));
+    arena.allocate(1, 1);
+    Arena level = arena.carve(256);
+    t.expect(level.isInitialized(), true);
+    t.expect(level.base, &arenaMemory[64]);
+    t.expect(level.capacity, size_t{256});
+    t.expect(arena.used, size_t{320});
+    level.allocate(256, 1);
+    t.expect(level.allocate(1, 1) == nullptr, true);
+    level.reset();
+    t.expect(level.allocate(1, 1) != nullptr, true);
+    t.expect(arena.carve(2048).isInitialized(), false);
+}
+
+void arenaPoisonsWhatItFrees(Test& t)
+{
+    Arena arena{};
+    arena.init(arenaMemory, sizeof(arenaMemory));
+    auto kept = arena.allocateSpan<uint8_t>(4);
+    std::memset(kept.data(), 1, kept.size());
+    const auto marker = arena.mark();
+    auto freed = arena.allocateSpan<uint8_t>(8);
+    std::memset(freed.data(), 2, freed.size());
+    arena.rewind(marker);
+    t.expect(kept[3], uint8_t{1});
+    t.expect(freed[0], ARENA_POISON ? ArenaPoison : uint8_t{2});
+    t.expect(freed[7], ARENA_POISON ? ArenaPoison : uint8_t{2});
+    arena.reset();
+    t.expect(kept[0], ARENA_POISON ? ArenaPoison : uint8_t{1});
+    t.expect(arena.allocateSpan<uint8_t>(2000).empty(), true);
+}
+
+void addAll(Test& t)
+{
+    t.add(arenaAligns);
+    t.add(arenaRunsOut);
+    t.add(arenaRewindsAndKeepsHighWater);
+    t.add(arenaKeepsWhatWasWrittenToTop);
+    t.add(arenaCarvesSubArenas);
+    t.add(arenaPoisonsWhatItFrees);
+}
+
+}
@@ -0,0 +1,97 @@
+//
+//  InputRecordingTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Utility/InputRecording.hpp"
+
+namespace InputRecordingTest {
+
+void varintRoundTrip(Test& t)
+{
+    uint8_t buffer[10];
+    for (uint64_t value : {0ull, 1ull, 127ull, 128ull, 300ull, 1ull << 40, ~0ull}) {
+        size_t written = InputRecording::writeVarint(buffer, value);
+        uint64_t read = 0;
+        t.expect(InputRecording::readVarint(buffer, written, read), written);
+        t.expect(read, value);
+    }
+}
+
+void unchangedFrameIsOneByte(Test& t)
+{
+    GameInput input{};
+    input.upTime_microseconds = 123456;
+    uint8_t buffer[InputRecording::MaxRecordSize];
+    t.expect(InputRecording::encodeDelta(input, input, buffer), size_t{1});
+}
+
+void deltaRoundTrip(Test& t)
+{
+    GameInput previous{};
+    GameInput current{};
+    uint8_t buffer[InputRecording::MaxRecordSize];
+
+    for (unsigned frame = 1; frame < 100; ++frame) {
+        current.frameNumber = frame;
+        current.upTime_microseconds += 16667;
+        current.elapsedTime_s = 0.016667;
+        current.mouse.trackLength = 1 + frame % 3;
+        current.mouse.track[frame % 3] = Vec2f{ .x = float(frame), .y = float(frame * 2) };
+        current.mouse.buttonLeft.endedDown = frame % 10 < 5;
+        current.controllers[frame % InputMaxControllers].isActive = frame % 2;
+        current.textLength = frame % 7 == 0 ? 3 : 0;
+        std::memcpy(current.text_utf8, "abc", 3);
+
+        size_t size = InputRecording::encodeDelta(previous, current, buffer);
+        t.expect(size < sizeof(GameInput) / 4, true);
+
+        GameInput decoded = previous;
+        t.expect(InputRecording::decodeDelta(buffer, size, decoded), size);
+        t.expect(std::memcmp(&decoded, &current, sizeof(GameInput)), 0);
+        previous = current;
+    }
+}
+
+void truncatedRecordIsRejected(Test& t)
+{
+    GameInput previous{};
+    GameInput current{};
+    current.upTime_microseconds = 1'000'000;
+    current.mouse.trackLength = 4;
+    uint8_t buffer[InputRecording::MaxRecordSize];
+    size_t size = InputRecording::encodeDelta(previous, current, buffer);
+    t.expect(InputRecording::decodeDelta(buffer, size - 1, previous), size_t{0});
+}
+
+void fullDiskFailsTheRecording(Test& t)
+{
+#ifdef __linux__
+    // every write to /dev/full fails with ENOSPC, the buffered ones at the latest on close
+    InputRecording::Recorder recorder{};
+    t.expect(recorder.open("/dev/full"), true);
+    GameInput input{};
+    for (int frame = 0; frame < 10; ++frame) {
+        input.frameNumber = frame;
+        recorder.record(input);
+    }
+    t.expect(recorder.close(), false);
+    t.expect(recorder.failed, true);
+    t.expect(recorder.error, ENOSPC);
+    t.expect(recorder.record(input), false);
+#endif
+}
+
+void addAll(Test& t)
+{
+    t.add(varintRoundTrip);
+    t.add(unchangedFrameIsOneByte);
+    t.add(deltaRoundTrip);
+    t.add(truncatedRecordIsRejected);
+    t.add(fullDiskFailsTheRecording);
+}
+
+}
@@ -0,0 +1,186 @@
+//
+//  RewindTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Utility/Rewind.hpp"
+#include <cstring>
+#include <vector>
+
+namespace RewindTest {
+
+compiletime size_t BlockSize = 4096;
+
+// a few scattered words and one longer stretch change every frame
+inline void simulateFrame(uint8_t* block, uint32_t frame)
+{
+    for (uint32_t i = 0; i < 8; ++i) {
+        const size_t offset = ((frame * 977 + i * 131) % (BlockSize / 4)) * 4;
+        std::memcpy(block + offset, &frame, 4);
+    }
+    if (frame % 5 == 0) {
+        std::memset(block + (frame * 64) % (BlockSize - 256), static_cast<int>(frame), 256);
+    }
+}
+
+void unchangedBlockIsEmptyDelta(Test& t)
+{
+    uint8_t before[BlockSize]{};
+    uint8_t out[Rewind::deltaSizeBound(BlockSize)];
+    before[100] = 1;
+    t.expect(Rewind::encodeXor(before, before, BlockSize, out), size_t{0});
+}
+
+void xorRoundTrip(Test& t)
+{
+    uint8_t before[BlockSize]{};
+    uint8_t after[BlockSize]{};
+    uint8_t out[Rewind::deltaSizeBound(BlockSize)];
+    simulateFrame(before, 3);
+    std::memcpy(after, before, BlockSize);
+    simulateFrame(after, 4);
+    after[BlockSize - 1] = 0xFF;
+
+    const size_t size = Rewind::encodeXor(before, after, BlockSize, out);
+    t.expect(size < BlockSize / 4, true);
+    uint8_t decoded[BlockSize];
+    std::memcpy(decoded, before, BlockSize);
+    t.expect(Rewind::applyXor(out, size, decoded, BlockSize), true);
+    t.expect(std::memcmp(decoded, after, BlockSize), 0);
+    // and back again
+    t.expect(Rewind::applyXor(out, size, decoded, BlockSize), true);
+    t.expect(std::memcmp(decoded, before, BlockSize), 0);
+    // against zeros
+    const size_t keyframeSize = Rewind::encodeXor(nullptr, after, BlockSize, out);
+    std::memset(decoded, 0, BlockSize);
+    t.expect(Rewind::applyXor(out, keyframeSize, decoded, BlockSize), true);
+    t.expect(std::memcmp(decoded, after, BlockSize), 0);
+}
+
+void everyWordChangedStaysInBound(Test& t)
+{
+    uint8_t before[BlockSize]{};
+    uint8_t after[BlockSize];
+    uint8_t out[Rewind::deltaSizeBound(BlockSize)];
+    // every other word, the gaps are too short to skip
+    for (size_t i = 0; i < BlockSize; ++i) {
+        after[i] = (i / Rewind::WordSize) % 2 ? 0 : 0xAB;
+    }
+    t.expect(Rewind::encodeXor(before, after, BlockSize, out) <= Rewind::deltaSizeBound(BlockSize), true);
+}
+
+void malformedDeltaIsRejected(Test& t)
+{
+    uint8_t block[64]{};
+    const uint8_t pastTheEnd[] = { 7, 2, 1, 2, 3, 4, 5, 6, 7, 8, 1, 2, 3, 4, 5, 6, 7, 8 };
+    t.expect(Rewind::applyXor(pastTheEnd, sizeof(pastTheEnd), block, sizeof(block)), false);
+    const uint8_t truncated[] = { 0, 1, 1, 2, 3 };
+    t.expect(Rewind::applyXor(truncated, sizeof(truncated), block, sizeof(block)), false);
+}
+
+// keeps a copy of every frame to compare the rewound block against
+struct History {
+    std::vector<std::vector<uint8_t>> frames;
+    uint8_t block[BlockSize]{};
+    uint32_t frame = 0;
+
+    void step(Rewind::Buffer& buffer) {
+        simulateFrame(block, ++frame);
+        buffer.snapshot(block, BlockSize);
+        frames.emplace_back(block, block + BlockSize);
+    }
+};
+
+void rewindRestoresEarlierFrames(Test& t)
+{
+    for (size_t keyframeInterval : { size_t{0}, size_t{8} }) {
+        Rewind::Buffer buffer{};
+        t.expect(buffer.init(BlockSize, 1024 * 1024, keyframeInterval, 100), true);
+        History history{};
+        for (int i = 0; i < 50; ++i) {
+            history.step(buffer);
+        }
+        t.expect(buffer.depth(), size_t{49});
+
+        for (size_t back : { size_t{1}, size_t{3}, size_t{20} }) {
+            t.expect(buffer.rewind(back, history.block), true);
+            history.frames.resize(history.frames.size() - back);
+            t.expect(std::memcmp(history.block, history.frames.back().data(), BlockSize), 0);
+        }
+        // and the history goes on from there
+        history.frame = 1000;
+        for (int i = 0; i < 10; ++i) {
+            history.step(buffer);
+        }
+        t.expect(buffer.rewind(buffer.depth(), history.block), true);
+        t.expect(std::memcmp(history.block, history.frames.front().data(), BlockSize), 0);
+        t.expect(buffer.rewind(1, history.block), false);
+    }
+}
+
+void memoryCapDropsOldestFrames(Test& t)
+{
+    Rewind::Buffer buffer{};
+    const size_t cap = BlockSize + 100 * sizeof(Rewind::Buffer::Frame) + 4 * Rewind::deltaSizeBound(BlockSize);
+    t.expect(buffer.init(BlockSize, cap, 4, 100), true);
+    t.expect(buffer.init(BlockSize, BlockSize, 4, 100), false);
+    History history{};
+    for (int i = 0; i < 300; ++i) {
+        history.step(buffer);
+        t.expect(buffer.bytesInUse() <= buffer.storageSize, true);
+    }
+    t.expect(buffer.depth() > 0, true);
+    t.expect(buffer.depth() < 99, true);
+
+    const size_t back = buffer.depth();
+    t.expect(buffer.rewind(back, history.block), true);
+    t.expect(std::memcmp(history.block, history.frames[history.frames.size() - 1 - back].data(), BlockSize), 0);
+}
+
+void frameLimitDropsOldestFrames(Test& t)
+{
+    Rewind::Buffer buffer{};
+    t.expect(buffer.init(BlockSize, 1024 * 1024, 10, 16), true);
+    History history{};
+    for (int i = 0; i < 40; ++i) {
+        history.step(buffer);
+    }
+    t.expect(buffer.depth(), size_t{15});
+    t.expect(buffer.rewind(15, history.block), true);
+    t.expect(std::memcmp(history.block, history.frames[40 - 16].data(), BlockSize), 0);
+}
+
+void onlyUsedPartIsTracked(Test& t)
+{
+    Rewind::Buffer buffer{};
+    t.expect(buffer.init(BlockSize, 1024 * 1024), true);
+    uint8_t block[BlockSize]{};
+    block[10] = 1;
+    block[BlockSize - 1] = 7;
+    buffer.snapshot(block, 13);
+    t.expect(buffer.extent, size_t{16});
+    block[10] = 2;
+    block[BlockSize - 1] = 8;
+    buffer.snapshot(block, 13);
+    t.expect(buffer.rewind(1, block), true);
+    t.expect(block[10], uint8_t{1});
+    // past the tracked part stays as it is
+    t.expect(block[BlockSize - 1], uint8_t{8});
+}
+
+void addAll(Test& t)
+{
+    t.add(unchangedBlockIsEmptyDelta);
+    t.add(xorRoundTrip);
+    t.add(everyWordChangedStaysInBound);
+    t.add(malformedDeltaIsRejected);
+    t.add(rewindRestoresEarlierFrames);
+    t.add(memoryCapDropsOldestFrames);
+    t.add(frameLimitDropsOldestFrames);
+    t.add(onlyUsedPartIsTracked);
+}
+
+}
@@ -0,0 +1,107 @@
+//
+//  TripleBufferTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Utility/TripleBuffer.hpp"
+#include <cstring>
+#include <thread>
+
+namespace TripleBufferTest {
+
+struct Frame {
+    int number;
+    std::array<int, 64> payload;
+};
+
+void nothingBeforeFirstPublish(Test& t)
+{
+    TripleBuffer<Frame> buffer;
+    std::memset(&buffer, 0, sizeof(buffer));
+    t.expect(buffer.hasPublished(), false);
+    t.expect(buffer.latest() == nullptr, true);
+    t.expect(buffer.fresh() == nullptr, true);
+}
+
+void latestAndFresh(Test& t)
+{
+    TripleBuffer<Frame> buffer;
+    std::memset(&buffer, 0, sizeof(buffer));
+    buffer.reset();
+
+    buffer.back().number = 1;
+    buffer.publish();
+    buffer.back().number = 2;
+    buffer.publish();
+    t.expect(buffer.hasPublished(), true);
+
+    // only the newest frame is seen, the first one was skipped
+    t.expect(buffer.fresh()->number, 2);
+    t.expect(buffer.fresh() == nullptr, true);
+    t.expect(buffer.latest()->number, 2);
+
+    buffer.back().number = 3;
+    t.expect(buffer.latest()->number, 2);
+    buffer.publish();
+    t.expect(buffer.latest()->number, 3);
+}
+
+void carryOver(Test& t)
+{
+    TripleBuffer<Frame> buffer;
+    std::memset(&buffer, 0, sizeof(buffer));
+    buffer.reset();
+
+    buffer.back().number = 7;
+    buffer.back().payload[3] = 42;
+    buffer.publishAndCarryOver();
+    t.expect(buffer.back().number, 7);
+    t.expect(buffer.back().payload[3], 42);
+    t.expect(buffer.latest()->payload[3], 42);
+}
+
+void producerConsumer(Test& t)
+{
+    constexpr int FrameCount = 100'000;
+    auto buffer = std::make_unique<TripleBuffer<Frame>>();
+    std::memset(buffer.get(), 0, sizeof(TripleBuffer<Frame>));
+    buffer->reset();
+
+    std::thread producer([&] {
+        for (int i = 1; i <= FrameCount; ++i) {
+            auto& frame = buffer->back();
+            frame.number = i;
+            frame.payload.fill(i);
+            buffer->publish();
+        }
+    });
+
+    int last = 0;
+    bool monotonic = true;
+    bool consistent = true;
+    while (last < FrameCount) {
+        if (const Frame* frame = buffer->latest()) {
+            monotonic &= frame->number >= last;
+            for (int value : frame->payload) {
+                consistent &= value == frame->number;
+            }
+            last = frame->number;
+        }
+    }
+    producer.join();
+    t.expect(monotonic, true);
+    t.expect(consistent, true);
+}
+
+void addAll(Test& t)
+{
+    t.add(nothingBeforeFirstPublish);
+    t.add(latestAndFresh);
+    t.add(carryOver);
+    t.add(producerConsumer);
+}
+
+}
@@ -0,0 +1,95 @@
+//
+//  WorkerPoolTest.hpp
+//  Project256
+//
+
+#pragma once
+
+#include "../Test.hpp"
+#include "../../game/Utility/WorkerPool.hpp"
+#include <vector>
+
+namespace WorkerPoolTest {
+
+void everyBandRunsOnce(Test& t)
+{
+    WorkerPool pool;
+    pool.start(4);
+    t.expect(pool.concurrency(), size_t{4});
+
+    bool allOnce = true;
+    for (int job = 0; job < 1000; ++job) {
+        std::array<std::atomic<int>, 7> calls{};
+        pool.run(calls.size(), [&](size_t band) { calls[band].fetch_add(1); });
+        for (auto& count : calls) {
+            allOnce &= count.load() == 1;
+        }
+    }
+    t.expect(allOnce, true);
+    pool.stop();
+    t.expect(pool.concurrency(), size_t{1});
+}
+
+void bandsCoverTheRows(Test& t)
+{
+    WorkerPool pool;
+    pool.start(3);
+    std::vector<std::atomic<int>> rows(200);
+    pool.forEachBand(10, 181, 16, [&](size_t first, size_t count) {
+        for (size_t row = first; row < first + count; ++row) {
+            rows[row].fetch_add(1);
+        }
+    });
+    bool covered = true;
+    for (size_t row = 0; row < rows.size(); ++row) {
+        covered &= rows[row].load() == (row >= 10 && row < 191 ? 1 : 0);
+    }
+    t.expect(covered, true);
+}
+
+void smallSpanStaysOnCaller(Test& t)
+{
+    WorkerPool pool;
+    pool.start(8);
+    int bands = 0;
+    pool.forEachBand(0, 20, 16, [&](size_t, size_t count) {
+        ++bands;
+        t.expect(count, size_t{20});
+    });
+    t.expect(bands, 1);
+}
+
+void startClampsTheThreadCount(Test& t)
+{
+    WorkerPool pool;
+    pool.start(0);
+    t.expect(pool.concurrency(), size_t{1});
+    pool.start(1);
+    t.expect(pool.concurrency(), size_t{1});
+    pool.start(WorkerPool::MaxThreads);
+    t.expect(pool.concurrency(), WorkerPool::MaxThreads);
+    pool.start(WorkerPool::MaxThreads + 1);
+    t.expect(pool.concurrency(), WorkerPool::MaxThreads + 1);
+    pool.start(WorkerPool::MaxThreads + 2);
+    t.expect(pool.concurrency(), WorkerPool::MaxThreads + 1);
+    pool.start(1000);
+    t.expect(pool.concurrency(), WorkerPool::MaxThreads + 1);
+
+    std::array<std::atomic<int>, 40> calls{};
+    pool.run(calls.size(), [&](size_t band) { calls[band].fetch_add(1); });
+    bool allOnce = true;
+    for (auto& count : calls) {
+        allOnce &= count.load() == 1;
+    }
+    t.expect(allOnce, true);
+}
+
+void addAll(Test& t)
+{
+    t.add(everyBandRunsOnce);
+    t.add(bandsCoverTheRows);
+    t.add(smallSpanStaysOnCaller);
+    t.add(startClampsTheThreadCount);
+}
+
+}